@@ -23,7 +23,9 @@ void TApplication::init(SDL_AudioCallback callback, void* udata, int sampleRate,
 	spec.userdata = udata;
 	spec.format = AUDIO_F32;
 
-	if ((m_device = SDL_OpenAudioDevice(NULL, 0, &spec, &m_spec, 0)) < 0) {
+	m_callback = callback;
+	m_udata = udata;
+	if ((m_device = SDL_OpenAudioDevice(NULL, 0, &spec, &m_spec, 0)) == 0) {
 		LogE(SDL_GetError());
 		return;
 	}
@@ -59,6 +61,35 @@ void TApplication::init(SDL_AudioCallback callback, void* udata, int sampleRate,
 	ImGuiSystem::Init(m_window);
 }
 
+bool TApplication::reopenAudio(int samples) {
+	SDL_AudioSpec spec = m_spec;
+	spec.samples = samples;
+	spec.callback = m_callback;
+	spec.userdata = m_udata;
+
+	SDL_CloseAudioDevice(m_device);
+
+	SDL_AudioSpec obtained;
+	SDL_AudioDeviceID device = SDL_OpenAudioDevice(NULL, 0, &spec, &obtained, 0);
+	if (device == 0) {
+		LogE(SDL_GetError());
+		// Try to get the old buffer back, at least
+		spec.samples = m_spec.samples;
+		if ((device = SDL_OpenAudioDevice(NULL, 0, &spec, &obtained, 0)) == 0) {
+			LogE(SDL_GetError());
+			m_device = 0;
+			return false;
+		}
+	}
+
+	m_device = device;
+	m_spec = obtained;
+	SDL_PauseAudioDevice(m_device, 0);
+
+	LogI("SAMPLES: ", m_spec.samples);
+	return int(m_spec.samples) == samples;
+}
+
 void TApplication::setupIcon() {
 	int w, h, comp;
 	unsigned char* data = stbi_load_from_memory(twist_png, twist_png_len, &w, &h, &comp, STBI_rgb_alpha);
@@ -40,6 +40,11 @@ public:
 	bool shouldClose() const { return m_shouldClose; }
 	void sync();
 
+	/// Reopens the audio device with a new buffer size, keeping everything else.
+	/// False if the driver gave another size (see spec()) or nothing opened.
+	bool reopenAudio(int samples);
+	bool audioOpen() const { return m_device != 0; }
+
 	virtual void gui(int width, int height) {}
 	virtual void input(SDL_Event evt) {}
 
@@ -54,6 +59,8 @@ private:
 
 	SDL_AudioDeviceID m_device;
 	SDL_AudioSpec m_spec;
+	SDL_AudioCallback m_callback;
+	void* m_udata;
 
 	bool m_shouldClose;
 };
@@ -8,7 +8,7 @@
 
 class TAddNodeCommand : public TCommand {
 public:
-	TAddNodeCommand(TNode *node, int x, int y, const Str& type, JSON params)
+	TAddNodeCommand(TNode *node, int x, int y, const Str& type, const JSON& params)
 		: m_params(params), m_type(type), m_x(x), m_y(y), m_node(node)
 	{}
 
@@ -29,7 +29,7 @@ private:
 
 class TDeleteNodeCommand : public TCommand {
 public:
-	TDeleteNodeCommand(TNode *node, int x, int y, const std::string& type, JSON params)
+	TDeleteNodeCommand(TNode *node, int x, int y, const std::string& type, const JSON& params)
 		: m_params(params), m_type(type), m_x(x), m_y(y), m_node(node)
 	{}
 
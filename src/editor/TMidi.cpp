@@ -1,10 +1,13 @@
 #include "TMidi.h"
 
 #include <stdio.h>
+#include <algorithm>
 #include <cassert>
 
+std::mutex TMessageBus::busLock;
 TMidiMessageQueue TMessageBus::messageQueue;
 TMidiMessageSubscriberList TMessageBus::subscribers;
+std::atomic<uint32_t> TMessageBus::liveCounter{ 0 };
 
 TMidiMessage::TMidiMessage(const TRawMidiMessage& data) {
 	command = (TMidiCommand)((data[0] & 0xF0) >> 4);
@@ -38,7 +41,15 @@ TRawMidiMessage TMidiMessage::raw() {
 
 void TMessageBus::subscribe(TMidiMessageSubscriber* sub) {
 	assert(sub != nullptr && "Subscriber shouldn't be null!");
-	subscribers.push_back(sub);
+	std::lock_guard<std::mutex> lock(busLock);
+	if (std::find(subscribers.begin(), subscribers.end(), sub) == subscribers.end()) {
+		subscribers.push_back(sub);
+	}
+}
+
+void TMessageBus::unsubscribe(TMidiMessageSubscriber* sub) {
+	std::lock_guard<std::mutex> lock(busLock);
+	subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), sub), subscribers.end());
 }
 
 void TMessageBus::broadcast(int channel, TMidiCommand command, TByte param0, TByte param1) {
@@ -47,7 +58,11 @@ void TMessageBus::broadcast(int channel, TMidiCommand command, TByte param0, TBy
 	msg.command = command;
 	msg.param0 = param0;
 	msg.param1 = param1;
-	messageQueue.push_back(msg);
+	{
+		std::lock_guard<std::mutex> lock(busLock);
+		messageQueue.push_back(msg);
+	}
+	liveCounter.fetch_add(1, std::memory_order_relaxed);
 }
 
 void TMessageBus::broadcast(int channel, TMidiCommand command, TShort param) {
@@ -57,13 +72,16 @@ void TMessageBus::broadcast(int channel, TMidiCommand command, TShort param) {
 }
 
 void TMessageBus::process() {
-	while (!messageQueue.empty()) {
-		TMidiMessage msg = messageQueue.front();
+	std::unique_lock<std::mutex> lock(busLock, std::try_to_lock);
+	if (!lock.owns_lock()) return;
+
+	for (const TMidiMessage& msg : messageQueue) {
 		for (TMidiMessageSubscriber* sub : subscribers) {
 			if (sub->midiChannel() == msg.channel || sub->midiChannel() == MIDI_CHANNEL_ALL) {
 				sub->messageReceived(msg);
 			}
 		}
-		messageQueue.erase(messageQueue.begin());
 	}
+	// Keeps the capacity, no deallocation here
+	messageQueue.clear();
 }
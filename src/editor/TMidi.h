@@ -3,8 +3,10 @@
 
 #include <cstdint>
 #include <array>
+#include <atomic>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include "RtMidi.h"
 
@@ -43,6 +45,7 @@ struct TMidiMessage {
 
 class TMidiMessageSubscriber {
 public:
+	virtual ~TMidiMessageSubscriber() = default;
 	virtual void messageReceived(TMidiMessage msg) = 0;
 	virtual int midiChannel() = 0;
 };
@@ -56,8 +59,18 @@ public:
 	static void broadcast(int channel, TMidiCommand command, TByte param0, TByte param1);
 	static void broadcast(int channel, TMidiCommand command, TShort param);
 	static void subscribe(TMidiMessageSubscriber* sub);
+	/// Subscribers must leave before they're destroyed.
+	static void unsubscribe(TMidiMessageSubscriber* sub);
+
+	/// Audio thread. Delivers the queued messages, unless another thread
+	/// holds the bus right now, in which case they wait for the next call.
 	static void process();
+
+	/// Counts broadcasts, i.e. live input from the keyboard or a MIDI device.
+	static uint32_t liveEvents() { return liveCounter.load(std::memory_order_relaxed); }
 private:
+	static std::atomic<uint32_t> liveCounter;
+	static std::mutex busLock;
 	static TMidiMessageQueue messageQueue;
 	static TMidiMessageSubscriberList subscribers;
 };
@@ -13,6 +13,7 @@ namespace fs = std::filesystem;
 
 #include "OsDialog.hpp"
 #include "TAudio.h"
+#include "twen/PatchExporter.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "imgui/imgui.h"
@@ -107,6 +108,18 @@ inline static float GetSquaredDistanceToBezierCurve(const ImVec2& point,const Im
 	return minSquaredDistance;
 }
 
+void TNodeEditor::registerNodes() {
+	// Headless renders (batch, export) drive them through MidiReceiver, only
+	// the editor's graph subscribes them to the live bus (see TNodeGraph::addNode)
+	NodeBuilder::registerType<MIDINode>("General", TWEN_NODE_FAC {
+		return new MIDINode(json);
+	}, Node::ControlRate);
+
+	NodeBuilder::registerType<SequencerNode>("Generators", TWEN_NODE_FAC {
+		return new SequencerNode(json);
+	}, Node::ControlRate);
+}
+
 TNodeEditor::TNodeEditor(const std::string& fileName) {
 	m_connection.from = nullptr;
 	m_connection.active = false;
@@ -123,9 +136,6 @@ TNodeEditor::TNodeEditor(const std::string& fileName) {
 	m_playIcon = nullptr;
 	m_stopIcon = nullptr;
 
-	m_recordingBufferPos = 0;
-	m_recordingBuffer.reserve(48000 * 90);
-
 	// Load recent files
 	std::ifstream fp(".recent");
 	if (!fp.bad()) {
@@ -140,36 +150,28 @@ TNodeEditor::TNodeEditor(const std::string& fileName) {
 	}
 
 	// Register GUIs
-	m_guis[ADSRNode::typeID()] = ADSR_gui;
-	m_guis[ArpNode::typeID()] = Arp_gui;
-	m_guis[ChorusNode::typeID()] = Chorus_gui;
-	m_guis[DelayLineNode::typeID()] = DelayLine_gui;
-	m_guis[FilterNode::typeID()] = Filter_gui;
-	m_guis[MathNode::typeID()] = Math_gui;
-	m_guis[MixNode::typeID()] = Mix_gui;
-	m_guis[NoteNode::typeID()] = Note_gui;
-	m_guis[OscillatorNode::typeID()] = Oscillator_gui;
-	m_guis[OutNode::typeID()] = Out_gui;
-	m_guis[ReaderNode::typeID()] = Reader_gui;
-	m_guis[WriterNode::typeID()] = Writer_gui;
-	m_guis[RemapNode::typeID()] = Remap_gui;
-	m_guis[ValueNode::typeID()] = Value_gui;
-	m_guis[ButtonNode::typeID()] = Button_gui;
-	m_guis[SequencerNode::typeID()] = Sequencer_gui;
-	m_guis[SamplerNode::typeID()] = Sampler_gui;
-	m_guis[MIDINode::typeID()] = MIDI_gui;
-	m_guis[HertzNode::typeID()] = Hertz_gui;
+	setGui(ADSRNode::kind(), ADSR_gui);
+	setGui(ArpNode::kind(), Arp_gui);
+	setGui(ChorusNode::kind(), Chorus_gui);
+	setGui(DelayLineNode::kind(), DelayLine_gui);
+	setGui(FilterNode::kind(), Filter_gui);
+	setGui(MathNode::kind(), Math_gui);
+	setGui(MixNode::kind(), Mix_gui);
+	setGui(NoteNode::kind(), Note_gui);
+	setGui(OscillatorNode::kind(), Oscillator_gui);
+	setGui(OutNode::kind(), Out_gui);
+	setGui(ReaderNode::kind(), Reader_gui);
+	setGui(WriterNode::kind(), Writer_gui);
+	setGui(RemapNode::kind(), Remap_gui);
+	setGui(ValueNode::kind(), Value_gui);
+	setGui(ButtonNode::kind(), Button_gui);
+	setGui(SequencerNode::kind(), Sequencer_gui);
+	setGui(SamplerNode::kind(), Sampler_gui);
+	setGui(MIDINode::kind(), MIDI_gui);
+	setGui(HertzNode::kind(), Hertz_gui);
 	//
 
-	NodeBuilder::registerType<MIDINode>("General", TWEN_NODE_FAC {
-		MIDINode* n = new MIDINode(json);
-		TMessageBus::subscribe(n);
-		return n;
-	});
-
-	NodeBuilder::registerType<SequencerNode>("Generators", TWEN_NODE_FAC {
-		return new SequencerNode(json);
-	});
+	registerNodes();
 
 	if (fileName.empty()) newGraph();
 	else menuActionOpen(fileName);
@@ -208,12 +210,13 @@ void TNodeEditor::menuActionOpen(const std::string& fileName) {
 		}
 	} else {
 		TNodeGraph* graph = newGraph();
-		graph->load(fileName);
+		// Sets the transport of the graph being played
+		paused([&]() { graph->loadAsync(fileName, m_loaderPool); });
 	}
 }
 
 void TNodeEditor::menuActionSave() {
-	if (m_nodeGraph) {
+	if (m_nodeGraph && !m_nodeGraph->loading()) {
 		if (m_nodeGraph->m_fileName.empty()) {
 			auto filePath = osd::Dialog::file(
 				osd::DialogAction::SaveFile,
@@ -236,7 +239,7 @@ void TNodeEditor::menuActionSave() {
 }
 
 void TNodeEditor::menuActionSaveAs() {
-	if (m_nodeGraph) {
+	if (m_nodeGraph && !m_nodeGraph->loading()) {
 		auto filePath = osd::Dialog::file(
 			osd::DialogAction::SaveFile,
 			".",
@@ -254,6 +257,35 @@ void TNodeEditor::menuActionSaveAs() {
 	}
 }
 
+void TNodeEditor::menuActionExport() {
+	if (m_nodeGraph && !m_nodeGraph->loading()) {
+		auto filePath = osd::Dialog::file(
+			osd::DialogAction::SaveFile,
+			".",
+			osd::Filters("C++ Source:cpp")
+		);
+
+		if (filePath.has_value()) {
+			fs::path fp = fs::u8path(filePath.value());
+			if (fp.extension().empty()) {
+				fp.replace_extension(".cpp");
+			}
+
+			JSON project;
+			m_nodeGraph->toJSON(project);
+
+			PatchExporter exporter;
+			if (!exporter.build(project, PatchExporter::classNameOf(fp.u8string())) || !exporter.write(fp.u8string())) {
+				osd::Dialog::message(
+					osd::MessageLevel::Error,
+					osd::MessageButtons::Ok,
+					"This patch could not be exported, see the log for details."
+				);
+			}
+		}
+	}
+}
+
 void TNodeEditor::menuActionExit() {
 	if (m_nodeGraph) {
 		if (!m_nodeGraph->m_saved) {
@@ -391,9 +423,11 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 		float thick = LINK_THICKNESS(scl);
 		cullLink.Expand(thick * 2.0f);
 
-		draw_list->AddCircleFilled(p1, NODE_SLOT_RADIUS2(scl), IM_COL32(200, 200, 100, 255));
-		draw_list->AddCircleFilled(p2, NODE_SLOT_RADIUS2(scl), IM_COL32(200, 200, 100, 255));
-		draw_list->AddBezierCurve(p1, cp1, cp2, p2, IM_COL32(200, 200, 100, 255), thick);
+		// Feedback links carry the previous sample
+		const ImU32 linkCol = conn->delayed ? IM_COL32(100, 180, 220, 255) : IM_COL32(200, 200, 100, 255);
+		draw_list->AddCircleFilled(p1, NODE_SLOT_RADIUS2(scl), linkCol);
+		draw_list->AddCircleFilled(p2, NODE_SLOT_RADIUS2(scl), linkCol);
+		draw_list->AddBezierCurve(p1, cp1, cp2, p2, linkCol, thick);
 
 		if (mustCheckForNearestLink && nearestConn == nullptr && cullLink.Contains(io.MousePos)) {
 			const float d = GetSquaredDistanceToBezierCurve(io.MousePos, p1, cp1, cp2, p2);
@@ -408,6 +442,12 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 		graph->disconnect(nearestConn);
 		m_lock.unlock();
 		nearestConn = nullptr;
+	} else if (nearestConn != nullptr && io.KeyCtrl && io.MouseReleased[1]) {
+		// Ctrl + right click makes a link an explicit feedback point
+		nearestConn->feedback = !nearestConn->feedback;
+		graph->m_actualNodeGraph->invalidate();
+		graph->m_saved = false;
+		nearestConn = nullptr;
 	}
 
 	// Display nodes
@@ -448,7 +488,7 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 			ImGui::PopStyleColor(3);
 			ImGui::SameLine(0, 2);
 
-			ImGui::Text("%s", nodeR->name().c_str());
+			ImGui::Text("%s", nodeR->label().empty() ? nodeR->name().c_str() : nodeR->label().c_str());
 
 			ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(1, 1, 1, 0));
 			ImGui::SameLine();
@@ -460,6 +500,23 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 			ImGui::PushID("NodeButtons");
 
 			if (node->closeable) {
+				// Amber while the loop is recorded, green once it replays
+				const bool frozen = graph->m_actualNodeGraph->frozen(nodeR);
+				if (frozen) {
+					const bool replaying = graph->m_actualNodeGraph->replaying(nodeR);
+					ImGui::PushStyleColor(ImGuiCol_Button, replaying ? ImVec4(0.3f, 0.6f, 0.3f, 1) : ImVec4(0.7f, 0.5f, 0.2f, 1));
+				}
+				if (ImGui::Button("F", ImVec2(15, 15))) {
+					m_lock.lock();
+					graph->m_actualNodeGraph->freeze(nodeR, !frozen);
+					graph->m_saved = false;
+					m_lock.unlock();
+				}
+				if (frozen) ImGui::PopStyleColor();
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("Freeze (replay one loop of this node and what feeds it)");
+				}
+				ImGui::SameLine();
 				if (ImGui::Button("C", ImVec2(15, 15))) {
 					m_lock.lock();
 					int cx = int(node->bounds.x);
@@ -493,7 +550,20 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 				ImGui::Spacing();
 				ImGui::Spacing();
 				ImGui::BeginGroup();
-				m_guis[nodeR->getType()](nodeR);
+				if (node->closeable) {
+					// Names the node for stem renders
+					char label[64];
+					std::snprintf(label, sizeof(label), "%s", nodeR->label().c_str());
+					ImGui::PushItemWidth(100);
+					if (ImGui::InputText("Label", label, sizeof(label))) {
+						nodeR->label(label);
+						graph->m_saved = false;
+					}
+					ImGui::PopItemWidth();
+				}
+				if (nodeR->getKind() < m_guis.size() && m_guis[nodeR->getKind()]) {
+					m_guis[nodeR->getKind()](nodeR);
+				}
 				ImGui::EndGroup();
 			}
 		ImGui::EndGroup();
@@ -524,7 +594,7 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 				if (!io.KeyCtrl) graph->unselectAll();
 				node->selected = true;
 				m_activeNode = node;
-				if (node->node->getType() == SequencerNode::typeID()) {
+				if (node->node->getKind() == SequencerNode::kind()) {
 					m_sequencerEditor = true;
 				}
 			} else if (io.KeyCtrl) {
@@ -566,9 +636,8 @@ void TNodeEditor::drawNodeGraph(TNodeGraph* graph) {
 
 		const ImVec2 hsz(slotRadius*1.5f, slotRadius*1.5f);
 
-		for (u32 in = 0; in < nodeR->inputs().size(); in++) {
-			Str name = nodeR->inNames()[in];
-			const char* label = name.c_str();
+		for (u32 in = 0; in < nodeR->inputCount(); in++) {
+			const char* label = nodeR->inName(in);
 			ImVec2 pos = offset + node->pos(in, slotRadius, m_snapToGrid);
 			if (node->open) pos.y += nodeTitleBarBgHeight;
 
@@ -908,6 +977,9 @@ void TNodeEditor::draw(int w, int h) {
 			if (ImGui::MenuItem("Save As...", "Ctrl+Shift+S")) {
 				menuActionSaveAs();
 			}
+			if (ImGui::MenuItem("Export C++...", nullptr, false, m_nodeGraph.get() != nullptr)) {
+				menuActionExport();
+			}
 			ImGui::Separator();
 			if (ImGui::MenuItem("Exit", "Ctrl+Q")) {
 				menuActionExit();
@@ -950,6 +1022,31 @@ void TNodeEditor::draw(int w, int h) {
 					m_snapToGridDisabled = true;
 				}
 			}
+			if (ImGui::MenuItem("Render Ahead", nullptr, &m_renderAheadEnabled)) {
+				if (m_renderAheadEnabled) {
+					startRenderAhead();
+				} else {
+					stopRenderAhead();
+				}
+			}
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("Renders on a separate thread, ahead of the device.\nPlaying live switches back to direct rendering until playback restarts.");
+			}
+			if (ImGui::BeginMenu("Audio Buffer")) {
+				for (int i = LatencyManager::Adaptive; i <= LatencyManager::Safe; i++) {
+					LatencyManager::Preset p = LatencyManager::Preset(i);
+					char label[48];
+					if (p == LatencyManager::Adaptive) {
+						std::snprintf(label, sizeof(label), "%s", LatencyManager::presetName(p));
+					} else {
+						std::snprintf(label, sizeof(label), "%s (%u)", LatencyManager::presetName(p), LatencyManager::presetFrames(p));
+					}
+					if (ImGui::MenuItem(label, nullptr, m_latency.preset() == p)) {
+						m_latency.preset(p);
+					}
+				}
+				ImGui::EndMenu();
+			}
 			ImGui::EndMenu();
 		}
 		ImGui::SameLine();
@@ -965,9 +1062,10 @@ void TNodeEditor::draw(int w, int h) {
 			ImGui::SameLine(0, 12);
 
 			ImGui::PushItemWidth(80);
-			float bpm = m_nodeGraph->actualNodeGraph()->bpm();
+			const float pending = m_pendingBpm.load();
+			float bpm = pending > 0.0f ? pending : m_nodeGraph->actualNodeGraph()->bpm();
 			if (ImGui::DragFloat("BPM", &bpm, 0.1f, 40, 240)) {
-				m_nodeGraph->actualNodeGraph()->bpm(bpm);
+				m_pendingBpm = bpm;
 			}
 			ImGui::SameLine();
 
@@ -986,6 +1084,37 @@ void TNodeEditor::draw(int w, int h) {
 			if (playPressed) {
 				m_playing = !m_playing;
 				reset();
+				m_renderAhead.resume();
+			}
+
+			// DSP load of the audio callback
+			ImGui::SameLine();
+			float load = m_monitor.load();
+			char dsp[32];
+			std::snprintf(dsp, sizeof(dsp), "DSP %d%%", int(load * 100.0f));
+			ImGui::PushStyleColor(
+				ImGuiCol_PlotHistogram,
+				load > 0.8f ? ImVec4(0.9f, 0.2f, 0.1f, 1.0f) : ImVec4(0.0f, 0.7f, 0.4f, 1.0f)
+			);
+			ImGui::ProgressBar(std::min(load, 1.0f), ImVec2(80, menuHeight - 4), dsp);
+			ImGui::PopStyleColor();
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip(
+					"Budget: %.2fms\nPeak: %d%%\nJitter: %d%%\nOverruns: %llu\nLate callbacks: %llu\n(click to reset the peak)",
+					m_monitor.budgetMs(),
+					int(m_monitor.peakLoad() * 100.0f),
+					int(m_monitor.jitter() * 100.0f),
+					(unsigned long long) m_monitor.overruns(),
+					(unsigned long long) m_monitor.late()
+				);
+				if (ImGui::IsMouseClicked(0)) m_monitor.resetPeak();
+			}
+
+			m_nodeGraph->update();
+			float progress = m_nodeGraph->loadProgress();
+			if (progress < 1.0f) {
+				ImGui::SameLine();
+				ImGui::ProgressBar(progress, ImVec2(120, menuHeight - 4), "Loading samples...");
 			}
 		}
 		ImGui::EndMainMenuBar();
@@ -1087,7 +1216,7 @@ void TNodeEditor::draw(int w, int h) {
 			bool recClick = ImGui::Button(m_recording ? "Stop" : "Record", ImVec2(50, 20));
 			if (m_recording) {
 				ImGui::SameLine();
-				float secRaw = (float(m_recordingBufferPos) / m_nodeGraph->actualNodeGraph()->sampleRate()) * 1000.0f;
+				float secRaw = (float(m_recorder.frames()) / m_nodeGraph->actualNodeGraph()->sampleRate()) * 1000.0f;
 				u32 secsRaw = u32(secRaw / 1000.0f);
 				u32 secs = secsRaw % 60;
 				u32 mins = secsRaw / 60;
@@ -1097,22 +1226,21 @@ void TNodeEditor::draw(int w, int h) {
 			}
 
 			if (recClick && m_nodeGraph) {
-				m_recording = !m_recording;
-				if (!m_recording) {
-					m_recordingBuffer = Vec<float>(
-								m_recordingBuffer.begin(),
-								m_recordingBuffer.begin() + m_recordingBufferPos
-					);
+				if (m_recording) {
+					m_recording = false;
+					m_recorder.stop();
+					m_hasTake = true;
 				} else {
-					const u32 maxSamples = m_nodeGraph->actualNodeGraph()->sampleRate() * MAX_SAMPLES_SECONDS;
-					m_recordingBuffer.resize(maxSamples);
-					std::fill(m_recordingBuffer.begin(), m_recordingBuffer.end(), 0.0f);
+					// Takes go to a temporary file until they are saved
+					const Str take = (fs::temp_directory_path() / "twist_take.wav").u8string();
+					const u32 sr = u32(m_nodeGraph->actualNodeGraph()->sampleRate());
+					m_hasTake = false;
+					m_recording = m_recorder.start(take, sr);
 				}
-				m_recordingBufferPos = 0;
 				reset();
 			}
 
-			if (!m_recordingBuffer.empty() && !m_playing && !m_recording) {
+			if (m_hasTake && !m_playing && !m_recording) {
 				ImGui::SameLine();
 				if (ImGui::Button("Save", ImVec2(50, 20))) {
 					auto filePath = osd::Dialog::file(
@@ -1127,10 +1255,25 @@ void TNodeEditor::draw(int w, int h) {
 							fp.replace_extension(".wav");
 						}
 
-						const u32 sr = u32(m_nodeGraph->actualNodeGraph()->sampleRate());
-						TAudioFile snd(fp.u8string(), true, sr);
-						snd.writef(m_recordingBuffer.data(), m_recordingBuffer.size());
-						std::fill(m_recordingBuffer.begin(), m_recordingBuffer.end(), 0.0f);
+						const fs::path take = fs::u8path(m_recorder.fileName());
+						std::error_code err;
+						fs::rename(take, fp, err);
+						if (err) {
+							// Different volume, copy instead
+							err.clear();
+							fs::copy_file(take, fp, fs::copy_options::overwrite_existing, err);
+							// The take is only dropped once it's safe at fp
+							std::error_code removeErr;
+							if (!err && !fs::remove(take, removeErr)) {
+								LogW("Could not remove the recorded take: ", removeErr.message());
+							}
+						}
+
+						if (err) {
+							LogE("Could not save the recording: ", err.message());
+						} else {
+							m_hasTake = false;
+						}
 					}
 				}
 			}
@@ -1142,13 +1285,17 @@ void TNodeEditor::draw(int w, int h) {
 
 			if (ImGui::BeginChild("##rec_buf", ImVec2(250, 70), false, flags)) {
 				ImVec2 sz = ImGui::GetContentRegionAvail();
-				ImGui::AudioView(
-					"##audio_view_rec_buf",
-					sz.x,
-					m_recordingBuffer.data(),
-					m_recordingBuffer.size(),
-					m_recordingBufferPos, sz.y
-				);
+				// Collapsed to nothing, e.g. while the window is resized
+				auto overview = m_recorder.overview(u32(std::max(sz.x, 0.0f)));
+				if (!overview.empty()) {
+					ImGui::PeakView(
+						"##audio_view_rec_buf",
+						sz.x,
+						&overview[0].min,
+						int(overview.size()),
+						1.0f, sz.y
+					);
+				}
 			}
 			ImGui::EndChild();
 
@@ -1171,24 +1318,26 @@ void TNodeEditor::draw(int w, int h) {
 
 			ImGui::BeginGroup();
 			float w = ImGui::GetContentRegionAvailWidth();
-			if (ImGui::Button("Load", ImVec2(w, 18))) {
+			// The decode tasks write into the library entries, which a sample of
+			// the same name would replace
+			if (!m_nodeGraph->loading() && ImGui::Button("Load", ImVec2(w, 18))) {
 				auto filePath = osd::Dialog::file(
 					osd::DialogAction::OpenFile,
 					".",
-					osd::Filters("Audio Files:wav,ogg,flac")
+					osd::Filters("Audio Files:wav,ogg,flac,mp3")
 				);
 
 				if (filePath.has_value()) {
-					if (!m_nodeGraph->actualNodeGraph()->addSample(filePath.value())) {
+					if (!m_nodeGraph->addSample(filePath.value(), m_loaderPool)) {
 						osd::Dialog::message(
 							osd::MessageLevel::Error,
 							osd::MessageButtons::Ok,
-							"Ivalid sample. It must be <= 15 seconds."
+							"Invalid sample. The file could not be read."
 						);
 					} else { saveBackup(); }
 				}
 			}
-			if (!items.empty()) {
+			if (!items.empty() && !m_nodeGraph->loading()) {
 				if (ImGui::Button("Del.", ImVec2(w, 18))) {
 					m_nodeGraph->actualNodeGraph()->removeSample(items[selectedSample]);
 					LogI("Deleted sample: ", items[selectedSample]);
@@ -1230,26 +1379,17 @@ void TNodeEditor::draw(int w, int h) {
 
 void TNodeEditor::closeGraph() {
 	m_playing = false;
-	if (m_nodeGraph) {
-		m_nodeGraph.reset();
-	}
 	newGraph();
 }
 
 void TNodeEditor::reset() {
 	m_lock.lock();
-#define CastNode(T, v) (dynamic_cast<T*>(v))
-	for (auto&& [k, v] : m_nodeGraph->m_tnodes) {
-		auto type = k->getType();
-		if (type == SamplerNode::typeID()) {
-			CastNode(SamplerNode, k)->sampleData.reset();
-		} else if (type == ADSRNode::typeID()) {
-			CastNode(ADSRNode, k)->adsr().reset();
-		} else if (type == OscillatorNode::typeID()) {
-			CastNode(OscillatorNode, k)->reset();
+	paused([this]() {
+		for (auto&& [k, v] : m_nodeGraph->m_tnodes) {
+			if (k->is(Node::Resettable)) k->reset();
 		}
-	}
-	m_nodeGraph->actualNodeGraph()->reset();
+		m_nodeGraph->actualNodeGraph()->reset();
+	});
 	m_lock.unlock();
 }
 
@@ -1259,16 +1399,56 @@ void TNodeEditor::saveBackup() {
 //	}
 }
 
+void TNodeEditor::setGui(NodeKind kind, const TNodeGUI& gui) {
+	if (kind >= m_guis.size()) m_guis.resize(kind + 1);
+	m_guis[kind] = gui;
+}
+
 TNodeGraph* TNodeEditor::newGraph() {
 	TNodeGraph* graph = new TNodeGraph(new NodeGraph(), 320, 240);
 
 	graph->m_name = "Untitled";
 	graph->m_editor = this;
 
-	m_nodeGraph = Ptr<TNodeGraph>(graph);
+	// Neither the engine thread nor the callback may be inside the old graph
+	stopRenderAhead();
+	Ptr<TNodeGraph> old;
+	{
+		std::lock_guard<std::mutex> lock(m_audioLock);
+		old = std::move(m_nodeGraph);
+		m_nodeGraph = Ptr<TNodeGraph>(graph);
+		m_pendingBpm = 0.0f;
+	}
+	old.reset();
+	if (m_renderAheadEnabled) startRenderAhead();
+
 	return m_nodeGraph.get();
 }
 
+void TNodeEditor::startRenderAhead() {
+	// The ring is resized, so the callback must not be reading it
+	std::lock_guard<std::mutex> lock(m_audioLock);
+	m_renderAhead.start([this](float* out, u32 frames) {
+		applyTempo();
+		for (u32 i = 0; i < frames; i++) out[i] = output();
+	});
+}
+
+void TNodeEditor::stopRenderAhead() {
+	std::lock_guard<std::mutex> lock(m_audioLock);
+	m_renderAhead.stop();
+}
+
+void TNodeEditor::paused(const std::function<void()>& fn) {
+	const bool ahead = m_renderAhead.running();
+	stopRenderAhead();
+	{
+		std::lock_guard<std::mutex> lock(m_audioLock);
+		fn();
+	}
+	if (ahead) startRenderAhead();
+}
+
 float TNodeEditor::output() {
 	float sample = 0.0f;
 
@@ -1278,17 +1458,40 @@ float TNodeEditor::output() {
 	}
 
 	if (m_recording) {
-		const u32 maxSamples = m_nodeGraph->actualNodeGraph()->sampleRate() * MAX_SAMPLES_SECONDS;
-		m_recordingBuffer[m_recordingBufferPos] = sample;
-		if (m_recordingBufferPos++ >= maxSamples) {
-			m_recordingBufferPos = 0;
-			m_recording = false;
-		}
+		m_recorder.write(sample);
 	}
 
 	return sample;
 }
 
+void TNodeEditor::render(float* out, u32 frames) {
+	std::unique_lock<std::mutex> lock(m_audioLock, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		// Paused by the GUI thread, which never holds it for long
+		std::fill(out, out + frames, 0.0f);
+		return;
+	}
+
+	// Live input needs the lowest latency, render it directly
+	u32 live = TMessageBus::liveEvents();
+	if (live != m_liveEvents) {
+		m_liveEvents = live;
+		m_renderAhead.bypass();
+	}
+
+	if (!m_renderAhead.read(out, frames)) {
+		applyTempo();
+		for (u32 i = 0; i < frames; i++) {
+			out[i] = output();
+		}
+	}
+}
+
+void TNodeEditor::applyTempo() {
+	const float bpm = m_pendingBpm.exchange(0.0f);
+	if (bpm > 0.0f && m_nodeGraph) m_nodeGraph->actualNodeGraph()->bpm(bpm);
+}
+
 void midiCallback(double dt, std::vector<uint8_t>* message, void* userData) {
 	unsigned int nBytes = message->size();
 	if (nBytes > 3) return;
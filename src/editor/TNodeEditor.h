@@ -12,6 +12,8 @@
 #include <fstream>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <functional>
 
 #include "TMidi.h"
 #include "TCommands.h"
@@ -19,6 +21,11 @@
 #include "TTex.h"
 
 #include "twen/intern/Utils.h"
+#include "twen/intern/AudioMonitor.h"
+#include "twen/intern/LatencyManager.h"
+#include "twen/intern/Recorder.h"
+#include "twen/intern/RenderAhead.h"
+#include "twen/intern/ThreadPool.h"
 #include "twen/NodeGraph.h"
 #include "twen/Node.h"
 
@@ -31,7 +38,6 @@
 #include "imgui.h"
 
 #define MAX_RECENT_FILES 8
-#define MAX_SAMPLES_SECONDS 90
 
 void midiCallback(double dt, std::vector<uint8_t>* message, void* userData);
 
@@ -40,6 +46,12 @@ public:
 	TNodeEditor(const std::string& fileName = "");
 	~TNodeEditor();
 
+	AudioMonitor& monitor() { return m_monitor; }
+	LatencyManager& latency() { return m_latency; }
+
+	/// Registers the engine nodes defined by the editor (MIDI, Sequencer).
+	static void registerNodes();
+
 	void draw(int w, int h);
 
 	bool snapToGrid() const { return m_snapToGrid; }
@@ -47,6 +59,10 @@ public:
 
 	float output();
 
+	/// Audio thread. Fills a device buffer, from the render-ahead ring when
+	/// enabled and rendering directly otherwise.
+	void render(float* out, u32 frames);
+
 	void closeGraph();
 	void reset();
 
@@ -61,10 +77,16 @@ public:
 
 private:
 	TNodeGraph* newGraph();
+	void startRenderAhead();
+	void stopRenderAhead();
+	/// Runs fn with the callback and the render-ahead thread paused, for
+	/// changes to what they play (the transport, the nodes' state).
+	void paused(const std::function<void()>& fn);
 	void drawNodeGraph(TNodeGraph* graph);
 	void menuActionOpen(const std::string& fileName="");
 	void menuActionSave();
 	void menuActionSaveAs();
+	void menuActionExport();
 	void menuActionSnapAllToGrid();
 	void saveRecentFiles();
 	void pushRecentFile(const std::string& str);
@@ -82,18 +104,37 @@ private:
 	Vec<TNode*> m_moving;
 	Map<TNode*, TMoveCommand::Point> m_moveDeltas;
 
-	Map<TypeIndex, TNodeGUI> m_guis;
+	// Indexed by NodeKind
+	Vec<TNodeGUI> m_guis;
+	void setGui(NodeKind kind, const TNodeGUI& gui);
 
 	ImVec2 m_mainWindowSize, m_selectionStart, m_selectionEnd;
 
 	bool m_playing = false, m_exit = false, m_recording = false,
 		m_showRecordingWindow = false, m_sequencerEditor = false;
 
-	Vec<float> m_recordingBuffer;
-	u32 m_recordingBufferPos;
+	Recorder m_recorder;
+	AudioMonitor m_monitor;
+	LatencyManager m_latency{ m_monitor };
+	bool m_hasTake = false;
 
+	// Must outlive m_nodeGraph, which may still have loading tasks queued
+	ThreadPool m_loaderPool;
 	Ptr<TNodeGraph> m_nodeGraph;
 
+	// Stopped before the graph goes away
+	RenderAhead m_renderAhead;
+	bool m_renderAheadEnabled = false;
+	// Held by render() for each callback. Taking it pauses the callback
+	// (it plays silence meanwhile), e.g. to swap the graph or resize the ring.
+	std::mutex m_audioLock;
+	u32 m_liveEvents = 0;
+
+	// Tempo set in the GUI (0 if none), the transport belongs to the audio
+	// thread, which applies it at the start of its next block
+	std::atomic<float> m_pendingBpm{ 0.0f };
+	void applyTempo();
+
 	Vec<Str> m_recentFiles;
 
 	Ptr<RtMidiIn> m_MIDIin;
@@ -1,16 +1,22 @@
 #include "TNodeGraph.h"
 
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
+#include <thread>
 #include <utility>
 
 #include "TCommands.h"
+#include "TMidi.h"
 #include "TNodeEditor.h"
 
 #include "nodes/OutNode.hpp"
+#include "twen/nodes/SamplerNode.hpp"
 
 TNodeGraph::TNodeGraph(NodeGraph* ang, int outX, int outY) {
 	m_actualNodeGraph = Ptr<NodeGraph>(std::move(ang));
+	// Played by the audio callback, edits reach it through update()
+	m_actualNodeGraph->realtime(true);
 	m_name = "Untitled";
 	m_undoRedo = Ptr<TUndoRedo>(new TUndoRedo());
 
@@ -20,12 +26,22 @@ TNodeGraph::TNodeGraph(NodeGraph* ang, int outX, int outY) {
 	out->closeable = false;
 }
 
+TNodeGraph::~TNodeGraph() {
+	// Pending decode tasks write into our sample library
+	m_cancelLoad = true;
+	while (m_samplesPending.load() > 0 || m_peaksPending.load() > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
 TNode* TNodeGraph::addNode(int x, int y,
-	const Str& type, JSON params, bool canundo
+	const Str& type, const JSON& params, bool canundo
 ) {
 	LogI("Adding editor node '", type, "' at x=", x, "y=", y);
 	TNode* n = new TNode();
 	n->node = m_actualNodeGraph->add(NodeBuilder::createNode(type, params));
+	// Live input, unsubscribed by the node's destructor
+	if (auto sub = dynamic_cast<TMidiMessageSubscriber*>(n->node)) TMessageBus::subscribe(sub);
 	n->closeable = true;
 	n->bounds.x = x;
 	n->bounds.y = y;
@@ -139,17 +155,134 @@ TNode* TNodeGraph::getActiveNode() {
 }
 
 void TNodeGraph::load(const Str& fileName) {
-	JSON json;
-
-	std::ifstream fp(fileName);
-	if (fp.good()) {
-		fp >> json;
-		fromJSON(json);
-		fp.close();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ProjectReader reader;
+	if (reader.read(fileName)) {
+		for (auto&& sample : reader.samples()) {
+			m_actualNodeGraph->addSample(
+				sample->name, std::move(sample->data), sample->sampleRate,
+				sample->path, sample->frames
+			);
+		}
+		fromJSON(reader.document());
 
 		m_saved = true;
 		m_fileName = fileName;
+
+		auto end = std::chrono::high_resolution_clock::now();
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		LogI("Loaded '", fileName, "' in ", ms, "ms (", reader.samples().size(), " samples)");
+	}
+}
+
+void TNodeGraph::loadAsync(const Str& fileName, ThreadPool& pool) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_reader = Ptr<ProjectReader>(new ProjectReader());
+	if (!m_reader->open(fileName)) {
+		m_reader.reset();
+		return;
+	}
+
+	// Register the (still empty) samples so the nodes can find them
+	Vec<RawSample*> targets;
+	for (auto&& sample : m_reader->samples()) {
+		m_actualNodeGraph->addSample(
+			sample->name, SampleBuffer(), sample->sampleRate,
+			sample->path, sample->frames
+		);
+		RawSample* target = m_actualNodeGraph->getSample(sample->name);
+		target->ready = false;
+		targets.push_back(target);
 	}
+
+	m_samplesTotal = targets.size();
+	m_samplesPending = targets.size();
+	m_cancelLoad = false;
+
+	fromJSON(m_reader->document());
+
+	m_saved = true;
+	m_fileName = fileName;
+
+	ProjectReader* reader = m_reader.get();
+	for (u32 i = 0; i < targets.size(); i++) {
+		RawSample* target = targets[i];
+		pool.submit([this, reader, target, i]() {
+			if (!m_cancelLoad) {
+				Vec<float> data;
+				reader->decode(i, data);
+				target->data = std::make_shared<const Vec<float>>(std::move(data));
+				m_actualNodeGraph->prepareSample(target);
+				if (target->streamed()) target->peaks = NodeGraph::buildPeaks(*target);
+				target->ready.store(true, std::memory_order_release);
+			}
+			m_samplesPending--;
+		});
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	LogI("Opened '", fileName, "' in ", ms, "ms, decoding ", targets.size(), " samples in the background");
+}
+
+bool TNodeGraph::addSample(const Str& fileName, ThreadPool& pool) {
+	RawSample* sample = m_actualNodeGraph->addSample(fileName);
+	if (sample == nullptr) return false;
+	if (!sample->streamed()) return true;
+
+	// Only the head is in memory, the overview needs the whole file
+	const Str name = sample->name, path = sample->path;
+	m_peaksPending++;
+	pool.submit([this, name, path]() {
+		if (!m_cancelLoad) {
+			RawSample scan;
+			scan.path = path;
+			auto peaks = NodeGraph::buildPeaks(scan);
+
+			std::lock_guard<std::mutex> lock(m_peaksLock);
+			m_peaks.push_back({ name, path, peaks });
+		}
+		m_peaksPending--;
+	});
+	return true;
+}
+
+void TNodeGraph::update() {
+	std::lock_guard<std::mutex> lock(m_peaksLock);
+	for (const ScannedPeaks& scanned : m_peaks) {
+		// The sample may have been removed or replaced meanwhile
+		RawSample* sample = m_actualNodeGraph->getSample(scanned.name);
+		if (sample != nullptr && sample->path == scanned.path) {
+			sample->peaks = scanned.peaks;
+		}
+	}
+	m_peaks.clear();
+
+	// Samplers that were loaded before their sample was decoded
+	for (auto&& [node, tnode] : m_tnodes) {
+		if (node->getKind() != SamplerNode::kind()) continue;
+		SamplerNode* sampler = static_cast<SamplerNode*>(node);
+		if (!sampler->pending()) continue;
+		RawSample* sample = m_actualNodeGraph->getSample(sampler->sampleName);
+		if (sample == nullptr || sample->ready.load(std::memory_order_acquire)) sampler->load();
+	}
+
+	m_actualNodeGraph->commit();
+}
+
+float TNodeGraph::loadProgress() {
+	if (m_samplesTotal == 0) return 1.0f;
+
+	u32 pending = m_samplesPending.load();
+	if (pending == 0) {
+		// Done, drop the file contents
+		m_reader.reset();
+		m_samplesTotal = 0;
+		return 1.0f;
+	}
+	return float(m_samplesTotal - pending) / float(m_samplesTotal);
 }
 
 void TNodeGraph::save(const std::string& fileName) {
@@ -165,72 +298,95 @@ void TNodeGraph::save(const std::string& fileName) {
 	}
 }
 
-void TNodeGraph::fromJSON(JSON json) {
-	m_name = json["title"];
-	m_scrolling.x = json["scroll"][0];
-	m_scrolling.y = json["scroll"][1];
-
-	float bpm = json.value("bpm", 120.0f);
-	u32 bars = json.value("bars", 4);
+void TNodeGraph::fromJSON(const JSON& json) {
+	m_name = json.value("title", m_name);
+	auto scroll = json.find("scroll");
+	if (scroll != json.end() && scroll->is_array() && scroll->size() >= 2) {
+		m_scrolling.x = (*scroll)[0];
+		m_scrolling.y = (*scroll)[1];
+	}
 
-	m_actualNodeGraph->bpm(bpm);
-	m_actualNodeGraph->bars(bars);
+	m_actualNodeGraph->loadTransport(json);
 
 	m_undoRedo.reset(new TUndoRedo());
 
 	TNode* outNode = m_tnodes.begin()->second.get();
-	outNode->bounds.x = json["outPos"][0];
-	outNode->bounds.y = json["outPos"][1];
-	outNode->gridPos.x = json["outPos"][0];
-	outNode->gridPos.y = json["outPos"][1];
+	auto outPos = json.find("outPos");
+	if (outPos != json.end() && outPos->is_array() && outPos->size() >= 2) {
+		outNode->bounds.x = (*outPos)[0];
+		outNode->bounds.y = (*outPos)[1];
+		outNode->gridPos.x = (*outPos)[0];
+		outNode->gridPos.y = (*outPos)[1];
+	}
 
 	// Load the samples
-	JSON samples = json["samples"];
-	if (samples.is_array()) {
-		for (u32 i = 0; i < samples.size(); i++) {
-			JSON jsample = samples[i];
-
-			Vec<float> data = jsample["data"];
-			Str sampleName = jsample["sampleName"];
-			float sampleRate = jsample["sampleRate"];
-
-			m_actualNodeGraph->addSample(sampleName, data, sampleRate);
+	auto samples = json.find("samples");
+	if (samples != json.end() && samples->is_array()) {
+		for (const JSON& jsample : *samples) {
+			Str sampleName = jsample.value("sampleName", Str());
+			float sampleRate = jsample.value("sampleRate", 44100.0f);
+
+			Str path = jsample.value("path", Str());
+			u64 frames = jsample.value("frames", u64(0));
+
+			auto data = jsample.find("data");
+			m_actualNodeGraph->addSample(
+				sampleName,
+				std::make_shared<const Vec<float>>(data != jsample.end() ? data->get<Vec<float>>() : Vec<float>()),
+				sampleRate, path, frames
+			);
 		}
 	}
 
 	// Load the nodes
-	JSON nodes = json["nodes"];
+	auto nodes = json.find("nodes");
 	Map<u32, TNode*> idnodeMap;
-	if (!nodes.is_array()) return;
+	if (nodes == json.end() || !nodes->is_array()) return;
 
 	idnodeMap[0] = outNode;
 
 	u32 nodeID = 1;
-	for (u32 i = 0; i < nodes.size(); i++) {
-		JSON node = nodes[i];
+	for (const JSON& node : *nodes) {
+		const u32 id = nodeID++;
+		Str type = node.value("type", Str());
+		if (NodeBuilder::factories.find(type) == NodeBuilder::factories.end()) {
+			LogE("Skipping a node of unknown type '", type, "'.");
+			continue;
+		}
 
-		Str type = node["type"];
-		float x = node["pos"][0];
-		float y = node["pos"][1];
+		float x = 0.0f, y = 0.0f;
+		auto pos = node.find("pos");
+		if (pos != node.end() && pos->is_array() && pos->size() >= 2) {
+			x = (*pos)[0];
+			y = (*pos)[1];
+		}
 
 		TNode* n = addNode(x, y, type, node, false);
 		n->node->load(node);
-		n->open = node["open"];
-		n->selected = node["selected"];
-		idnodeMap[nodeID++] = n;
+		n->open = node.value("open", n->open);
+		n->selected = node.value("selected", false);
+		if (node.value("frozen", false)) m_actualNodeGraph->freeze(n->node, true);
+		idnodeMap[id] = n;
 	}
 
 	// Connect the nodes
-	JSON connections = json["connections"];
-	if (!connections.is_array()) return;
-
-	for (u32 i = 0; i < connections.size(); i++) {
-		JSON conn = connections[i];
+	auto connections = json.find("connections");
+	if (connections == json.end() || !connections->is_array()) return;
+
+	for (const JSON& conn : *connections) {
+		auto from = idnodeMap.find(conn.value("from", u32(-1)));
+		auto to = idnodeMap.find(conn.value("to", u32(-1)));
+		u32 slot = conn.value("slot", u32(-1));
+		if (from == idnodeMap.end() || to == idnodeMap.end() || slot >= to->second->node->inputCount()) {
+			LogE("Skipping an invalid connection: ", conn.dump());
+			continue;
+		}
 
-		TNode *from = idnodeMap[conn["from"].get<u32>()];
-		TNode *to = idnodeMap[conn["to"].get<u32>()];
-		u32 slot = conn["slot"];
-		connect(from, to, slot, false);
+		Connection* c = connect(from->second, to->second, slot, false);
+		if (c != nullptr && conn.value("feedback", false)) {
+			c->feedback = true;
+			m_actualNodeGraph->invalidate();
+		}
 	}
 }
 
@@ -241,8 +397,7 @@ void TNodeGraph::toJSON(JSON& json) {
 	TNode* outNode = m_tnodes.begin()->second.get();
 	json["outPos"] = { outNode->gridPos.x, outNode->gridPos.y };
 
-	json["bpm"] = m_actualNodeGraph->bpm();
-	json["bars"] = m_actualNodeGraph->bars();
+	m_actualNodeGraph->saveTransport(json);
 
 	// Save the Nodes
 	JSON nodes = JSON::array();
@@ -250,12 +405,13 @@ void TNodeGraph::toJSON(JSON& json) {
 
 	u32 i = 0;
 	for (auto&& [k, v] : m_tnodes) {
-		if (k->getType() == OutNode::typeID()) continue;
+		if (k->getKind() == OutNode::kind()) continue;
 
 		JSON node; k->save(node);
 		node["pos"] = { v->gridPos.x, v->gridPos.y };
 		node["open"] = v->open;
 		node["selected"] = v->selected;
+		if (m_actualNodeGraph->frozen(k)) node["frozen"] = true;
 		nodes[i] = node;
 		nodeidMap[k] = i+1;
 		i++;
@@ -271,6 +427,7 @@ void TNodeGraph::toJSON(JSON& json) {
 		jconn["from"] = nodeidMap[conn->from];
 		jconn["to"] = nodeidMap[conn->to];
 		jconn["slot"] = conn->toSlot;
+		if (conn->feedback) jconn["feedback"] = true;
 		connections[i++] = jconn;
 	}
 	json["connections"] = connections;
@@ -279,10 +436,15 @@ void TNodeGraph::toJSON(JSON& json) {
 	JSON samples = JSON::array();
 	for (auto&& [id, sample] : m_actualNodeGraph->sampleLibrary()) {
 		JSON jsample;
-		jsample["data"] = sample->data;
-		jsample["sampleSize"] = sample->data.size();
+		jsample["data"] = *sample->data;
+		jsample["sampleSize"] = sample->data->size();
 		jsample["sampleName"] = id;
 		jsample["sampleRate"] = sample->sampleRate;
+		if (sample->streamed()) {
+			// Only the head is stored, the rest is streamed from the original file
+			jsample["path"] = sample->path;
+			jsample["frames"] = sample->frames;
+		}
 		samples.push_back(jsample);
 	}
 	json["samples"] = samples;
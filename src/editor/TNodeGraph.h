@@ -9,7 +9,10 @@
 #include "TUndoRedo.h"
 #include "twen/Node.h"
 #include "twen/NodeGraph.h"
+#include "twen/ProjectReader.h"
+#include "twen/intern/ThreadPool.h"
 
+#include <atomic>
 #include <functional>
 
 using TNodeGUI = std::function<void(Node*)>;
@@ -40,8 +43,9 @@ class TNodeGraph {
 	friend class TNodeEditor;
 public:
 	TNodeGraph(NodeGraph* ang, int outX, int outY);
+	~TNodeGraph();
 
-	TNode* addNode(int x, int y, const Str& type, JSON params, bool canundo=true);
+	TNode* addNode(int x, int y, const Str& type, const JSON& params, bool canundo=true);
 	void removeNode(TNode *nd, bool canundo=true);
 	Connection* connect(TNode *from, TNode *to, u32 slot, bool canundo=true);
 
@@ -52,8 +56,20 @@ public:
 	void disconnect(Connection* conn, bool canundo=true);
 
 	void load(const Str& fileName);
+	void loadAsync(const Str& fileName, ThreadPool& pool);
 	void save(const Str& fileName);
 
+	bool loading() const { return m_samplesPending.load() > 0; }
+	float loadProgress();
+
+	/// Adds a sound file to the sample library. Streamed files get their
+	/// waveform overview later, scanned on pool (see update).
+	bool addSample(const Str& fileName, ThreadPool& pool);
+
+	/// Takes in the results of background work (overviews, decoded samples)
+	/// and hands the edits to the audio thread (see NodeGraph::commit), once per frame.
+	void update();
+
 	TNodeEditor* editor() { return m_editor; }
 	void editor(TNodeEditor* ed) { m_editor = ed; }
 
@@ -61,7 +77,7 @@ public:
 	TUndoRedo* undoRedo() { return m_undoRedo.get(); }
 	Str name() const { return m_name; }
 
-	void fromJSON(JSON json);
+	void fromJSON(const JSON& json);
 	void toJSON(JSON& json);
 
 protected:
@@ -74,6 +90,19 @@ protected:
 
 	Map<Node*, Ptr<TNode>> m_tnodes;
 
+	Ptr<ProjectReader> m_reader;
+	std::atomic<u32> m_samplesPending{ 0 };
+	std::atomic<bool> m_cancelLoad{ false };
+	u32 m_samplesTotal{ 0 };
+
+	struct ScannedPeaks {
+		Str name, path;
+		std::shared_ptr<const PeakPyramid> peaks;
+	};
+	std::mutex m_peaksLock;
+	Vec<ScannedPeaks> m_peaks;
+	std::atomic<u32> m_peaksPending{ 0 };
+
 	ImVec2 m_scrolling;
 
 	Str m_name, m_fileName;
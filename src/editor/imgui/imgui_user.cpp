@@ -252,7 +252,7 @@ bool LinkText(const char* text) {
 	return pressed;
 }
 
-void AudioView(const char* id, float width, float* values, int length, int pos, float h) {
+void AudioView(const char* id, float width, const float* values, int length, int pos, float h) {
 	const int col = IM_COL32(0, 200, 100, 255);
 	const int coll = IM_COL32(0, 255, 190, 255);
 
@@ -319,6 +319,41 @@ void AudioView(const char* id, float width, float* values, int length, int pos,
 
 }
 
+// peaks holds (min, max, rms) for each column, progress is the cursor position in [0, 1]
+void PeakView(const char* id, float width, const float* peaks, int columns, float progress, float h) {
+	const int col = IM_COL32(0, 200, 100, 255);
+	const int colRms = IM_COL32(0, 255, 190, 255);
+
+	const ImVec2 wp = ImGui::GetCursorScreenPos();
+	ImGui::InvisibleButton(id, ImVec2(width, h));
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	const ImVec2 rect_max = ImVec2(width, h) + wp;
+
+	draw_list->AddRectFilled(wp, rect_max, IM_COL32(0, 0, 0, 255));
+	draw_list->PushClipRect(wp, rect_max, true);
+
+	const float h2 = h / 2;
+	draw_list->AddLine(ImVec2(0.0f, h2) + wp, ImVec2(width, h2) + wp, IM_COL32(80, 80, 80, 255));
+
+	if (peaks != nullptr) {
+		const int n = std::min(columns, int(width));
+		for (int x = 0; x < n; x++) {
+			const float mn = std::max(peaks[x * 3 + 0], -1.0f) * 0.999f;
+			const float mx = std::min(peaks[x * 3 + 1], 1.0f) * 0.999f;
+			const float rms = std::min(peaks[x * 3 + 2], 1.0f);
+			draw_list->AddLine(ImVec2(x, h2 - mx * h2) + wp, ImVec2(x, h2 - mn * h2 + 1) + wp, col);
+			draw_list->AddLine(ImVec2(x, h2 - rms * h2) + wp, ImVec2(x, h2 + rms * h2 + 1) + wp, colRms);
+		}
+	}
+
+	const float pos_r = progress * width;
+	draw_list->AddLine(ImVec2(pos_r, 0) + wp, ImVec2(pos_r, h) + wp, IM_COL32(200, 100, 100, 255));
+
+	draw_list->PopClipRect();
+	draw_list->AddRect(wp, rect_max, IM_COL32(100, 100, 100, 255));
+}
+
 bool KeyBed(const char* id, bool* keys, int keyCount) {
 	if (keyCount <= 0) return false;
 
@@ -462,7 +497,7 @@ bool RubberButton(const char* id) {
 	return ret;
 }
 
-void DrawAudioView(float x, float y, float width, float* values, int length, float h, float rad, int corners) {
+void DrawAudioView(float x, float y, float width, const float* values, int length, float h, float rad, int corners) {
 	const UINT32 col = IM_COL32(0, 200, 100, 255);
 
 	const ImVec2 wp = ImVec2(x, y);
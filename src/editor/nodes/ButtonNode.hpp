@@ -18,6 +18,8 @@ public:
 		return Value(val, val, active);
 	}
 
+	bool deterministic() const override { return false; }
+
 	bool active;
 };
 
@@ -6,21 +6,26 @@
 #include "../imgui/imgui_internal.h"
 
 #include "twen/NodeGraph.h"
+#include "twen/MidiFile.h"
 #include "../TMidi.h"
 
-class MIDINode : public Node, public TMidiMessageSubscriber  {
+class MIDINode : public Node, public TMidiMessageSubscriber, public MidiReceiver {
 	TWEN_NODE(MIDINode, "MIDI In")
 public:
 	inline MIDINode()
 		: Node()
 	{}
 
-	inline MIDINode(JSON param)
+	inline MIDINode(const JSON& param)
 		: Node()
 	{
 		load(param);
 	}
 
+	inline ~MIDINode() {
+		TMessageBus::unsubscribe(this);
+	}
+
 	inline void messageReceived(TMidiMessage msg) override {
 		switch (msg.command) {
 			default: break;
@@ -39,6 +44,20 @@ public:
 
 	inline int midiChannel() override { return channel; }
 
+	inline void midiEvent(const MidiEvent& event) override {
+		messageReceived(TMidiMessage(TRawMidiMessage{ event.status, event.data0, event.data1 }));
+	}
+
+	inline void saveState(StateWriter& w) const override {
+		w << out;
+	}
+
+	inline void restoreState(StateReader& r) override {
+		r >> out;
+	}
+
+	inline bool deterministic() const override { return false; }
+
 	inline Value sample(NodeGraph *graph) override {
 		return out;
 	}
@@ -50,12 +69,11 @@ public:
 		json["to"] = to;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		if (json["channel"].is_null()) return;
-		channel = json["channel"].get<u32>();
-		from = json["from"].get<u32>();
-		to = json["to"].get<u32>();
+		channel = json.value("channel", channel);
+		from = json.value("from", from);
+		to = json.value("to", to);
 	}
 
 	u32 channel{ 15 };
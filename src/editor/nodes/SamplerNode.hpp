@@ -32,12 +32,25 @@ static void Sampler_gui(Node* node) {
 		n->load();
 	}
 
-	ImGui::AudioView(
+	// Drawn from the sample's overview, one peak per pixel
+	const float width = 130.0f;
+	RawSample* raw = n->graph()->getSample(n->sampleName);
+	Vec<PeakPyramid::Peak> peaks;
+	if (raw != nullptr && raw->ready.load(std::memory_order_acquire) && raw->peaks) {
+		peaks = raw->peaks->columns(0, raw->peaks->frames(), u32(width));
+	}
+
+	float progress = 0.0f;
+	if (n->sampleData.length() > 0) {
+		progress = float(n->sampleData.frame()) / float(n->sampleData.length());
+	}
+
+	ImGui::PeakView(
 				"_sample",
-				130,
-				n->sampleData.sampleData().data(),
-				n->sampleData.sampleData().size(),
-				n->sampleData.frame(),
+				width,
+				peaks.empty() ? nullptr : &peaks[0].min,
+				int(peaks.size()),
+				progress,
 				50.0f
 	);
 	ImGui::PopItemWidth();
@@ -26,7 +26,7 @@ public:
 		addInput("Base");
 	}
 
-	inline SequencerNode(JSON param)
+	inline SequencerNode(const JSON& param)
 		: SequencerNode()
 	{
 		load(param);
@@ -76,17 +76,19 @@ public:
 		json["notes"] = notes;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		if (!json["notes"].is_array()) return;
+		auto jnotes = json.find("notes");
+		if (jnotes == json.end() || !jnotes->is_array()) return;
 
-		for (u32 i = 0; i < json["notes"].size(); i++) {
-			JSON note = json["notes"][i];
+		const u32 count = std::min(u32(jnotes->size()), u32(TWIST_SEQUENCER_SIZE));
+		for (u32 i = 0; i < count; i++) {
+			const JSON& note = (*jnotes)[i];
 			SNote n;
-			n.vel = note["vel"];
-			n.octave = note["oct"];
-			n.note = note["note"];
-			n.active = note["active"];
+			n.vel = note.value("vel", n.vel);
+			n.octave = note.value("oct", n.octave);
+			n.note = note.value("note", n.note);
+			n.active = note.value("active", n.active);
 			notes[i] = n;
 		}
 	}
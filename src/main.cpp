@@ -1,9 +1,13 @@
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
 #include <memory>
 
 #include "twen/intern/Log.h"
 #include "twen/Twen.h"
+#include "twen/BatchRenderer.h"
+#include "twen/PatchExporter.h"
+#include "twen/ProjectReader.h"
 #include "editor/TApplication.h"
 #include "editor/TNodeEditor.h"
 
@@ -20,6 +24,11 @@ public:
 		m_editor = new TNodeEditor(fileName);
 		init(audioCallback, m_editor);
 		m_editor->sampleRate = spec().freq;
+
+		m_editor->monitor().configure(spec().samples, spec().freq);
+		if (const char* counters = std::getenv("TWIST_COUNTERS_FILE")) {
+			m_editor->monitor().startReporting(counters);
+		}
 	}
 
 	virtual ~App() {}
@@ -37,6 +46,19 @@ public:
 	void start() {
 		while (!shouldClose()) {
 			sync();
+
+			u32 samples = m_editor->latency().update(spec().samples);
+			if (samples > 0) {
+				// Before reopening, the first callback of the new device may come right away
+				m_editor->monitor().restart();
+				if (!reopenAudio(int(samples))) {
+					// Asking again would only reopen the device every few seconds
+					if (!audioOpen()) LogE("No audio device could be opened.");
+					m_editor->latency().pin(spec().samples);
+				}
+				if (audioOpen()) m_editor->monitor().configure(spec().samples, spec().freq);
+			}
+
 			if (m_editor->exit()) {
 				this->exit();
 			}
@@ -56,10 +78,13 @@ static void audioCallback(void* ud, Uint8* stream, int length) {
 	int flen = length / int(sizeof(float));
 	float* fstream = reinterpret_cast<float*>(stream);
 
+	// Never wait on the logger from here
+	Log::realtimeThread();
+
 	if (editor != nullptr) {
-		for (int i = 0; i < flen; i++) {
-			fstream[i] = editor->output();
-		}
+		editor->monitor().begin();
+		editor->render(fstream, u32(flen));
+		editor->monitor().end();
 	}
 }
 
@@ -68,6 +93,27 @@ int main(int argc, char** argv) {
 
 	Twen::init();
 
+	// Headless batch rendering: Twist --batch manifest.json
+	if (argc > 2 && std::strcmp(argv[1], "--batch") == 0) {
+		TNodeEditor::registerNodes();
+
+		BatchRenderer batch;
+		if (!batch.load(argv[2])) return 1;
+		return batch.run() == 0 ? 0 : 1;
+	}
+
+	// Patch to C++: Twist --export project.syn Patch.cpp
+	if (argc > 3 && std::strcmp(argv[1], "--export") == 0) {
+		TNodeEditor::registerNodes();
+
+		ProjectReader reader;
+		if (!reader.open(argv[2])) return 1;
+
+		PatchExporter exporter;
+		if (!exporter.build(reader.document(), PatchExporter::classNameOf(argv[3]))) return 1;
+		return exporter.write(argv[3]) ? 0 : 1;
+	}
+
 	App* app = new App(argc > 1 ? std::string(argv[1]) : "");
 #ifdef WINDOWS
 	FreeConsole();
@@ -3,38 +3,66 @@
 #include <algorithm>
 #include <cctype>
 #include <fstream>
-#include <vector>
 
 TAudioFile::TAudioFile()
 	: m_flac(nullptr),
 	  m_wav(nullptr),
+	  m_mp3(nullptr),
 	  m_ogg(nullptr),
-	  m_type(Invalid)
+	  m_type(Invalid),
+	  m_format(PCM16),
+	  m_ditherEnabled(false),
+	  m_frames(0),
+	  m_sampleRate(0),
+	  m_channels(0)
 {}
 
-TAudioFile::TAudioFile(const std::string& fileName, bool write, uint32_t sampleRate) {
+TAudioFile::TAudioFile(
+	const std::string& fileName,
+	bool write,
+	uint32_t sampleRate,
+	uint32_t channels,
+	SampleFormat format
+)
+	: m_flac(nullptr),
+	  m_wav(nullptr),
+	  m_mp3(nullptr),
+	  m_ogg(nullptr),
+	  m_type(Invalid),
+	  m_format(format),
+	  m_ditherEnabled(false),
+	  m_frames(0),
+	  m_sampleRate(0),
+	  m_channels(0)
+{
 	m_fileName = fileName;
-	std::string ext = fileName.substr(fileName.find_last_of('.'));
+	auto dot = fileName.find_last_of('.');
+	std::string ext = dot == std::string::npos ? "" : fileName.substr(dot);
 	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
 	if (!write) {
 		std::string id4(4, 0);
 		std::string id(3, 0);
-		std::ifstream fp(fileName);
+		std::ifstream fp(fileName, std::ios::binary);
 		if (fp.good()) {
 			fp.read(id4.data(), 4);
 			fp.close();
 			id = id4.substr(0, 3);
 		}
 
+		// MPEG audio frames start with an 11-bit sync word
+		const bool mpegSync = uint8_t(id4[0]) == 0xFF && (uint8_t(id4[1]) & 0xE0) == 0xE0;
+
 		if (id4 == "RIFF" && (ext == ".wav" || ext == ".wave")) {
 			m_wav = drwav_open_file(fileName.c_str());
+			if (m_wav == nullptr) return;
 			m_channels = m_wav->channels;
 			m_sampleRate = m_wav->sampleRate;
 			m_frames = m_wav->totalPCMFrameCount;
 			m_type = Wav;
 		} else if (id4 == "fLaC" && ext == ".flac") {
 			m_flac = drflac_open_file(fileName.c_str());
+			if (m_flac == nullptr) return;
 			m_channels = m_flac->channels;
 			m_sampleRate = m_flac->sampleRate;
 			m_frames = m_flac->totalPCMFrameCount;
@@ -42,51 +70,123 @@ TAudioFile::TAudioFile(const std::string& fileName, bool write, uint32_t sampleR
 		} else if (id == "Ogg" && ext == ".ogg") {
 			int error;
 			m_ogg = stb_vorbis_open_filename(fileName.c_str(), &error, nullptr);
+			if (m_ogg == nullptr) return;
 			stb_vorbis_info info = stb_vorbis_get_info(m_ogg);
 			m_channels = info.channels;
 			m_sampleRate = info.sample_rate;
 			m_frames = stb_vorbis_stream_length_in_samples(m_ogg);
 			m_type = Ogg;
+		} else if ((id == "ID3" || mpegSync) && ext == ".mp3") {
+			m_mp3 = new drmp3();
+			if (!drmp3_init_file(m_mp3, fileName.c_str(), nullptr)) {
+				delete m_mp3;
+				m_mp3 = nullptr;
+				return;
+			}
+			m_channels = m_mp3->channels;
+			m_sampleRate = m_mp3->sampleRate;
+			// MP3 has no length header, this scans the file once
+			m_frames = drmp3_get_pcm_frame_count(m_mp3);
+			m_type = Mp3;
 		} else {
 			m_type = Invalid;
 		}
 	} else {
-		if (ext == ".wav" || ext == ".wave") {
+		if ((ext == ".wav" || ext == ".wave") && channels > 0) {
 			drwav_data_format fmt;
 			fmt.container = drwav_container_riff;
-			fmt.format = DR_WAVE_FORMAT_PCM;
-			fmt.channels = 1;
+			fmt.format = format == Float32 ? DR_WAVE_FORMAT_IEEE_FLOAT : DR_WAVE_FORMAT_PCM;
+			fmt.channels = channels;
 			fmt.sampleRate = sampleRate;
-			fmt.bitsPerSample = 16;
+			fmt.bitsPerSample = uint32_t(format);
 			m_wav = drwav_open_file_write(fileName.c_str(), &fmt);
+			if (m_wav == nullptr) return;
+
+			m_channels = channels;
+			m_sampleRate = sampleRate;
 			m_type = Wav;
+			if (format != Float32) {
+				m_scratch.resize(TAUDIO_WRITE_CHUNK * channels * (uint32_t(format) / 8));
+			}
 		}
 	}
 }
 
 TAudioFile::~TAudioFile() {
+	close();
+}
+
+void TAudioFile::close() {
 	switch (m_type) {
 		default: break;
 		case Wav: drwav_close(m_wav); break;
 		case Flac: drflac_close(m_flac); break;
 		case Ogg: stb_vorbis_close(m_ogg); break;
+		case Mp3: drmp3_uninit(m_mp3); delete m_mp3; break;
 	}
+	m_wav = nullptr;
+	m_flac = nullptr;
+	m_ogg = nullptr;
+	m_mp3 = nullptr;
+	m_type = Invalid;
 }
 
-uint64_t TAudioFile::readf(float* outdata, uint32_t outsize) {
+uint64_t TAudioFile::readf(float* outdata, uint64_t frames) {
 	switch (m_type) {
 		default: return 0;
-		case Wav: return drwav_read_pcm_frames_f32(m_wav, outsize, outdata);
-		case Flac: return drflac_read_pcm_frames_f32(m_flac, outsize, outdata);
-		case Ogg: return stb_vorbis_get_samples_float_interleaved(m_ogg, m_channels, outdata, outsize);
+		case Wav: return drwav_read_pcm_frames_f32(m_wav, frames, outdata);
+		case Flac: return drflac_read_pcm_frames_f32(m_flac, frames, outdata);
+		case Mp3: return drmp3_read_pcm_frames_f32(m_mp3, frames, outdata);
+		case Ogg: {
+			// stb_vorbis takes an int sample count, so read in pieces
+			uint64_t total = 0;
+			while (total < frames) {
+				int n = int(std::min<uint64_t>(frames - total, 1 << 20));
+				int got = stb_vorbis_get_samples_float_interleaved(
+					m_ogg, m_channels, outdata + total * m_channels, n * m_channels
+				);
+				total += got;
+				if (got < n) break;
+			}
+			return total;
+		}
+	}
+}
+
+bool TAudioFile::seek(uint64_t frame) {
+	switch (m_type) {
+		default: return false;
+		case Wav: return drwav_seek_to_pcm_frame(m_wav, frame);
+		case Flac: return drflac_seek_to_pcm_frame(m_flac, frame);
+		case Mp3: return drmp3_seek_to_pcm_frame(m_mp3, frame);
+		case Ogg: return stb_vorbis_seek(m_ogg, (unsigned int) frame) != 0;
 	}
 }
 
-uint64_t TAudioFile::writef(float* indata, uint32_t insize) {
-	if (m_type != Wav) return 0;
-	std::vector<int16_t> samples; samples.resize(insize);
-	for (uint32_t i = 0; i < insize; i++) {
-		samples[i] = static_cast<int16_t>(indata[i] * 32767.0f);
+uint64_t TAudioFile::writef(const float* indata, uint64_t frames) {
+	if (m_type != Wav || m_wav == nullptr) return 0;
+
+	if (m_format == Float32) {
+		return drwav_write_pcm_frames(m_wav, frames, indata);
+	}
+
+	TAudioConvert::Dither* dither = m_ditherEnabled ? &m_dither : nullptr;
+
+	uint64_t written = 0;
+	while (written < frames) {
+		uint64_t n = std::min<uint64_t>(frames - written, TAUDIO_WRITE_CHUNK);
+		const float* src = indata + written * m_channels;
+		size_t count = size_t(n * m_channels);
+
+		if (m_format == PCM16) {
+			TAudioConvert::floatToInt16(src, reinterpret_cast<int16_t*>(m_scratch.data()), count, dither);
+		} else {
+			TAudioConvert::floatToInt24(src, m_scratch.data(), count, dither);
+		}
+
+		uint64_t w = drwav_write_pcm_frames(m_wav, n, m_scratch.data());
+		written += w;
+		if (w < n) break;
 	}
-	return drwav_write_pcm_frames(m_wav, samples.size(), (void*) samples.data());
+	return written;
 }
@@ -2,11 +2,18 @@
 #define TAUDIO_H
 
 #include "intern/dr_flac.h"
+#include "intern/dr_mp3.h"
 #include "intern/dr_wav.h"
 #include "intern/stb_vorbis.h"
 
+#include "TAudioConvert.h"
+
 #include <string>
 #include <cstdint>
+#include <vector>
+
+// Frames converted per step when writing integer formats
+#define TAUDIO_WRITE_CHUNK 1024
 
 class TAudioFile {
 public:
@@ -14,15 +21,49 @@ public:
 		Invalid = 0,
 		Wav,
 		Ogg,
-		Flac
+		Flac,
+		Mp3
+	};
+
+	/// Sample format of written WAV files.
+	enum SampleFormat {
+		PCM16 = 16,
+		PCM24 = 24,
+		Float32 = 32
 	};
 
 	TAudioFile();
-	TAudioFile(const std::string& fileName, bool write = false, uint32_t sampleRate = 44100);
+	/// Opens fileName for reading (WAV, FLAC, OGG or MP3) or, if write is set,
+	/// creates a WAV file with the given rate, channel count and format.
+	TAudioFile(
+		const std::string& fileName,
+		bool write = false,
+		uint32_t sampleRate = 44100,
+		uint32_t channels = 1,
+		SampleFormat format = PCM16
+	);
 	~TAudioFile();
 
-	uint64_t readf(float* outdata, uint32_t outsize);
-	uint64_t writef(float* indata, uint32_t insize);
+	TAudioFile(const TAudioFile&) = delete;
+	TAudioFile& operator=(const TAudioFile&) = delete;
+
+	/// Reads up to frames interleaved frames into outdata. Returns the number of frames read.
+	uint64_t readf(float* outdata, uint64_t frames);
+
+	/// Writes frames interleaved frames from indata. Never allocates.
+	/// Returns the number of frames written.
+	uint64_t writef(const float* indata, uint64_t frames);
+
+	bool seek(uint64_t frame);
+
+	/// Finishes the file (writes the final WAV header). Called by the destructor.
+	void close();
+
+	/// Enables TPDF dither when writing integer formats.
+	void dither(bool enable) { m_ditherEnabled = enable; }
+
+	bool valid() const { return m_type != Invalid; }
+	FileType type() const { return m_type; }
 
 	uint64_t frames() const { return m_frames; }
 	uint32_t sampleRate() const { return m_sampleRate; }
@@ -31,9 +72,16 @@ public:
 private:
 	drflac *m_flac;
 	drwav *m_wav;
+	drmp3 *m_mp3;
 	stb_vorbis *m_ogg;
 	FileType m_type;
 
+	// Writing
+	SampleFormat m_format;
+	std::vector<uint8_t> m_scratch;
+	TAudioConvert::Dither m_dither;
+	bool m_ditherEnabled;
+
 	// Info
 	uint64_t m_frames;
 	uint32_t m_sampleRate;
@@ -0,0 +1,132 @@
+#include "TAudioConvert.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TAUDIO_SSE2
+#endif
+
+namespace TAudioConvert {
+
+	// xorshift32 per lane; lane i of the SIMD path and sample i % 4 of the
+	// scalar path use the same generator, so both produce identical output.
+	static inline uint32_t next(uint32_t& x) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return x;
+	}
+
+	// Sum of two uniform values, in [-1, 1) LSB
+	static inline float tpdf(Dither* d, size_t lane) {
+		uint32_t& s = d->state[lane & 3];
+		float a = float(next(s) >> 8);
+		float b = float(next(s) >> 8);
+		return (a + b) * (1.0f / 16777216.0f) - 1.0f;
+	}
+
+	static inline float quantize(float v, float scale, float lo, float hi, Dither* d, size_t i) {
+		v = std::min(std::max(v, -1.0f), 1.0f) * scale;
+		if (d) v += tpdf(d, i);
+		return std::min(std::max(v, lo), hi);
+	}
+
+#ifdef TAUDIO_SSE2
+	static inline __m128i nextx4(__m128i& x) {
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+		return x;
+	}
+
+	static inline __m128 tpdfx4(__m128i& x) {
+		__m128 a = _mm_cvtepi32_ps(_mm_srli_epi32(nextx4(x), 8));
+		__m128 b = _mm_cvtepi32_ps(_mm_srli_epi32(nextx4(x), 8));
+		return _mm_sub_ps(_mm_mul_ps(_mm_add_ps(a, b), _mm_set1_ps(1.0f / 16777216.0f)), _mm_set1_ps(1.0f));
+	}
+
+	// Scales, dithers and rounds 4 samples to int32
+	static inline __m128i quantizex4(const float* in, __m128 scale, __m128 lo, __m128 hi, __m128i* state) {
+		__m128 v = _mm_loadu_ps(in);
+		v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+		v = _mm_mul_ps(v, scale);
+		if (state) v = _mm_add_ps(v, tpdfx4(*state));
+		v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+		return _mm_cvtps_epi32(v);
+	}
+#endif
+
+	void floatToInt16(const float* in, int16_t* out, size_t count, Dither* dither) {
+		size_t i = 0;
+#ifdef TAUDIO_SSE2
+		const __m128 scale = _mm_set1_ps(32767.0f);
+		const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+		__m128i state = dither ? _mm_loadu_si128((const __m128i*) dither->state) : _mm_setzero_si128();
+		for (; i + 8 <= count; i += 8) {
+			__m128i a = quantizex4(in + i, scale, lo, hi, dither ? &state : nullptr);
+			__m128i b = quantizex4(in + i + 4, scale, lo, hi, dither ? &state : nullptr);
+			_mm_storeu_si128((__m128i*) (out + i), _mm_packs_epi32(a, b));
+		}
+		if (dither) _mm_storeu_si128((__m128i*) dither->state, state);
+#endif
+		for (; i < count; i++) {
+			out[i] = int16_t(std::lrint(quantize(in[i], 32767.0f, -32768.0f, 32767.0f, dither, i)));
+		}
+	}
+
+	void floatToInt24(const float* in, uint8_t* out, size_t count, Dither* dither) {
+		size_t i = 0;
+#ifdef TAUDIO_SSE2
+		const __m128 scale = _mm_set1_ps(8388607.0f);
+		const __m128 lo = _mm_set1_ps(-8388608.0f), hi = _mm_set1_ps(8388607.0f);
+		__m128i state = dither ? _mm_loadu_si128((const __m128i*) dither->state) : _mm_setzero_si128();
+		alignas(16) int32_t lanes[4];
+		for (; i + 4 <= count; i += 4) {
+			_mm_store_si128((__m128i*) lanes, quantizex4(in + i, scale, lo, hi, dither ? &state : nullptr));
+			for (size_t k = 0; k < 4; k++) {
+				uint8_t* o = out + (i + k) * 3;
+				o[0] = uint8_t(lanes[k]);
+				o[1] = uint8_t(lanes[k] >> 8);
+				o[2] = uint8_t(lanes[k] >> 16);
+			}
+		}
+		if (dither) _mm_storeu_si128((__m128i*) dither->state, state);
+#endif
+		for (; i < count; i++) {
+			int32_t v = int32_t(std::lrint(quantize(in[i], 8388607.0f, -8388608.0f, 8388607.0f, dither, i)));
+			uint8_t* o = out + i * 3;
+			o[0] = uint8_t(v);
+			o[1] = uint8_t(v >> 8);
+			o[2] = uint8_t(v >> 16);
+		}
+	}
+
+	void int16ToFloat(const int16_t* in, float* out, size_t count) {
+		size_t i = 0;
+#ifdef TAUDIO_SSE2
+		const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		for (; i + 8 <= count; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+			// Sign-extend to 32 bits
+			__m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+		}
+#endif
+		for (; i < count; i++) {
+			out[i] = float(in[i]) * (1.0f / 32768.0f);
+		}
+	}
+
+	void int24ToFloat(const uint8_t* in, float* out, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t* s = in + i * 3;
+			int32_t v = int32_t(uint32_t(s[0]) << 8 | uint32_t(s[1]) << 16 | uint32_t(s[2]) << 24) >> 8;
+			out[i] = float(v) * (1.0f / 8388608.0f);
+		}
+	}
+
+}
@@ -0,0 +1,23 @@
+#ifndef TAUDIO_CONVERT_H
+#define TAUDIO_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Sample format conversion kernels. All of them work on caller-owned
+/// buffers and never allocate. Float samples are in [-1, 1] and clipped.
+namespace TAudioConvert {
+	/// Triangular (TPDF) dither state. Pass nullptr to the converters to skip dithering.
+	struct Dither {
+		uint32_t state[4] = { 0x9E3779B9u, 0x243F6A88u, 0xB7E15162u, 0x5A827999u };
+	};
+
+	void floatToInt16(const float* in, int16_t* out, size_t count, Dither* dither = nullptr);
+	/// Packed little-endian 24-bit, 3 bytes per sample.
+	void floatToInt24(const float* in, uint8_t* out, size_t count, Dither* dither = nullptr);
+
+	void int16ToFloat(const int16_t* in, float* out, size_t count);
+	void int24ToFloat(const uint8_t* in, float* out, size_t count);
+}
+
+#endif // TAUDIO_CONVERT_H
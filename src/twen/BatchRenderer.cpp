@@ -0,0 +1,309 @@
+#include "BatchRenderer.h"
+
+#include "MidiFile.h"
+#include "ProjectReader.h"
+#include "Renderer.h"
+#include "TAudio.h"
+#include "intern/Log.h"
+#include "intern/ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+bool BatchRenderer::load(const Str& manifestFile) {
+	JSON manifest;
+	{
+		std::ifstream fp(manifestFile);
+		if (!fp.good()) {
+			LogE("Could not open the manifest: ", manifestFile);
+			return false;
+		}
+		try {
+			fp >> manifest;
+		} catch (const std::exception& e) {
+			LogE("Invalid manifest: ", e.what());
+			return false;
+		}
+	}
+
+	// Paths in the manifest are relative to it
+	const fs::path base = fs::u8path(manifestFile).parent_path();
+	auto resolve = [&](const Str& p) {
+		fs::path path = fs::u8path(p);
+		return (path.is_absolute() ? path : base / path).u8string();
+	};
+
+	m_output = resolve(manifest.value("output", Str(".")));
+	m_sampleRate = manifest.value("sampleRate", 44100.0f);
+	m_format = manifest.value("format", 16u);
+	m_threads = manifest.value("threads", 0u);
+	const double seconds = manifest.value("seconds", 0.0);
+
+	if (m_format != 16 && m_format != 24 && m_format != 32) {
+		LogE("Invalid format: ", m_format, ". Use 16, 24 or 32.");
+		return false;
+	}
+
+	m_samples.sampleRate(m_sampleRate);
+	auto samples = manifest.find("samples");
+	if (samples != manifest.end() && samples->is_array()) {
+		for (const JSON& s : *samples) {
+			if (!m_samples.addSample(resolve(s.get<Str>()))) {
+				LogE("Could not load sample: ", s.get<Str>());
+				return false;
+			}
+		}
+		Renderer::loadStreamed(m_samples);
+	}
+
+	auto jobs = manifest.find("jobs");
+	if (jobs == manifest.end() || !jobs->is_array()) {
+		LogE("The manifest has no jobs.");
+		return false;
+	}
+
+	for (const JSON& jjob : *jobs) {
+		if (jjob.count("project") == 0) {
+			LogE("Job without a project.");
+			return false;
+		}
+
+		Job job;
+		job.project = resolve(jjob["project"].get<Str>());
+		job.overrides = jjob.value("overrides", JSON::array());
+		job.seconds = jjob.value("seconds", seconds);
+		job.start = jjob.value("start", 0.0);
+		if (jjob.count("midi") != 0) job.midi = resolve(jjob["midi"].get<Str>());
+		job.stems = jjob.value("stems", JSON::array());
+		job.parallel = jjob.value("parallel", false);
+
+		if (m_projects.find(job.project) == m_projects.end()) {
+			ProjectReader reader;
+			if (!reader.read(job.project)) {
+				LogE("Could not read project: ", job.project);
+				return false;
+			}
+
+			Ptr<Project> project = Ptr<Project>(new Project());
+			project->document = reader.document();
+			project->samples.sampleRate(m_sampleRate);
+			for (auto&& sample : reader.samples()) {
+				project->samples.addSample(
+					sample->name, std::move(sample->data), sample->sampleRate,
+					sample->path, sample->frames
+				);
+			}
+			Renderer::loadStreamed(project->samples);
+			m_projects[job.project] = std::move(project);
+		}
+
+		auto sweep = jjob.find("sweep");
+		if (sweep == jjob.end()) {
+			m_jobs.push_back(job);
+			continue;
+		}
+
+		for (const JSON& value : (*sweep)["values"]) {
+			Job variant = job;
+			variant.overrides.push_back({
+				{ "node", (*sweep)["node"] },
+				{ "param", (*sweep)["param"] },
+				{ "value", value }
+			});
+			m_jobs.push_back(variant);
+		}
+	}
+
+	for (u32 i = 0; i < m_jobs.size(); i++) {
+		char name[32];
+		std::snprintf(name, sizeof(name), "%04u.wav", i + 1);
+		m_jobs[i].file = (fs::u8path(m_output) / name).u8string();
+	}
+
+	return true;
+}
+
+u32 BatchRenderer::run() {
+	std::error_code err;
+	fs::create_directories(fs::u8path(m_output), err);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		ThreadPool pool(m_threads);
+		LogI("Rendering ", m_jobs.size(), " jobs on ", pool.size(), " threads");
+		// Parallel jobs split their share of the threads, not all of them
+		m_jobThreads = std::max<u32>(1, pool.size() / std::max<u32>(1, u32(m_jobs.size())));
+		for (Job& job : m_jobs) {
+			pool.submit([this, &job]() {
+				// A bad override (e.g. a value of the wrong type) only fails its own job
+				try {
+					render(job);
+				} catch (const std::exception& e) {
+					job.ok = false;
+					job.error = e.what();
+					LogE("Job ", job.file, " failed: ", e.what());
+				}
+			});
+		}
+		pool.wait();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+	writeSummary();
+
+	u32 failed = 0;
+	for (const Job& job : m_jobs) {
+		if (!job.ok) failed++;
+	}
+	LogI("Rendered ", m_jobs.size() - failed, "/", m_jobs.size(), " jobs in ", ms, "ms");
+	return failed;
+}
+
+void BatchRenderer::render(Job& job) {
+	auto start = std::chrono::high_resolution_clock::now();
+	const Project& project = *m_projects.find(job.project)->second;
+
+	JSON document = project.document;
+	for (const JSON& ov : job.overrides) {
+		u32 node = ov.value("node", 0u);
+		Str param = ov.value("param", Str());
+		if (node >= document["nodes"].size() || param.empty() || ov.count("value") == 0) {
+			job.error = "Invalid override: " + ov.dump();
+			LogE(job.error);
+			return;
+		}
+		document["nodes"][node][param] = ov["value"];
+	}
+
+	Renderer renderer(m_sampleRate);
+	renderer.shareSamples(project.samples);
+	renderer.shareSamples(m_samples);
+	if (!renderer.build(document)) {
+		job.error = "Invalid project";
+		return;
+	}
+
+	renderer.graph().seekBar(job.start);
+
+	u64 frames = job.seconds > 0.0 ? u64(job.seconds * m_sampleRate) : renderer.loopLength();
+	if (!job.midi.empty()) {
+		MidiFile midi;
+		if (!midi.open(job.midi)) {
+			job.error = "Could not read " + job.midi;
+			return;
+		}
+		renderer.midi(midi.events(m_sampleRate));
+		if (job.seconds <= 0.0) frames = u64((midi.length() + TWEN_BATCH_MIDI_TAIL) * m_sampleRate);
+	}
+
+	if (job.parallel && !job.stems.empty()) {
+		job.error = "Stems can't be rendered in parallel";
+		return;
+	}
+
+	Vec<Renderer::Stem> stems;
+	Vec<Str> stemFileNames;
+	const Vec<Node*>& nodes = renderer.nodes();
+	for (const JSON& ref : job.stems) {
+		Node* node = renderer.findNode(ref);
+		if (node == nullptr) {
+			job.error = "Invalid stem: " + ref.dump();
+			return;
+		}
+		for (const Renderer::Stem& stem : stems) {
+			if (stem.node == node) {
+				job.error = "Stem listed twice: " + ref.dump();
+				return;
+			}
+		}
+		stems.push_back({ node, nullptr });
+
+		// Labels are free text, keep the file name portable. Sanitizing can
+		// make two labels equal, the node index keeps the names apart.
+		const u32 index = u32(std::find(nodes.begin(), nodes.end(), node) - nodes.begin());
+		Str stem = std::to_string(index);
+		if (ref.is_string()) {
+			Str label = ref.get<Str>();
+			for (char& c : label) {
+				if (!std::isalnum(u8(c)) && c != '-' && c != '_') c = '_';
+			}
+			stem = label + "-" + stem;
+		}
+		const fs::path file = fs::u8path(job.file);
+		stemFileNames.push_back((file.parent_path() / (file.stem().u8string() + "-" + stem + ".wav")).u8string());
+	}
+
+	TAudioFile out(job.file, true, u32(m_sampleRate), 1, TAudioFile::SampleFormat(m_format));
+	if (!out.valid()) {
+		job.error = "Could not create " + job.file;
+		LogE(job.error);
+		return;
+	}
+	out.dither(m_format != 32);
+
+	job.stemFiles = stemFileNames;
+	Vec<Ptr<TAudioFile>> stemFiles;
+	for (u32 i = 0; i < job.stems.size(); i++) {
+		Ptr<TAudioFile> file = Ptr<TAudioFile>(new TAudioFile(job.stemFiles[i], true, u32(m_sampleRate), 1, TAudioFile::SampleFormat(m_format)));
+		if (!file->valid()) {
+			job.error = "Could not create " + job.stemFiles[i];
+			LogE(job.error);
+			return;
+		}
+		file->dither(m_format != 32);
+		stems[i].file = file.get();
+		stemFiles.push_back(std::move(file));
+	}
+
+	if (job.parallel) {
+		job.frames = renderer.renderParallel(out, frames, m_jobThreads);
+	} else {
+		job.frames = renderer.render(out, frames, stems);
+	}
+	job.peak = renderer.peak();
+	job.rms = renderer.rms();
+	job.ok = job.frames == frames;
+	if (!job.ok) job.error = "Short write";
+
+	auto end = std::chrono::high_resolution_clock::now();
+	job.renderMs = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void BatchRenderer::writeSummary() {
+	JSON summary;
+	summary["sampleRate"] = m_sampleRate;
+	summary["format"] = m_format;
+
+	JSON jobs = JSON::array();
+	for (u32 i = 0; i < m_jobs.size(); i++) {
+		const Job& job = m_jobs[i];
+		JSON jjob;
+		jjob["index"] = i + 1;
+		jjob["project"] = job.project;
+		jjob["overrides"] = job.overrides;
+		if (!job.midi.empty()) jjob["midi"] = job.midi;
+		if (!job.stemFiles.empty()) jjob["stems"] = job.stemFiles;
+		if (job.parallel) jjob["parallel"] = true;
+		jjob["file"] = job.file;
+		jjob["ok"] = job.ok;
+		jjob["frames"] = job.frames;
+		jjob["seconds"] = double(job.frames) / m_sampleRate;
+		jjob["peak"] = job.peak;
+		jjob["rms"] = job.rms;
+		jjob["renderMs"] = job.renderMs;
+		if (!job.error.empty()) jjob["error"] = job.error;
+		jobs.push_back(jjob);
+	}
+	summary["jobs"] = jobs;
+
+	std::ofstream fp(fs::u8path(m_output) / "summary.json");
+	fp << std::setw(4) << summary << std::endl;
+}
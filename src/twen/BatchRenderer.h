@@ -0,0 +1,87 @@
+#ifndef TWEN_BATCH_RENDERER_H
+#define TWEN_BATCH_RENDERER_H
+
+#include "NodeGraph.h"
+
+// Seconds rendered after the last event of a MIDI job without a length, for the release tails
+#define TWEN_BATCH_MIDI_TAIL 2.0
+
+/// Renders many variants of one or more projects in parallel.
+///
+/// The manifest is a JSON file:
+///	{
+///		"output": "renders",	// directory for the WAVs and summary.json
+///		"sampleRate": 44100,
+///		"format": 16,			// 16, 24 or 32 (float)
+///		"threads": 0,			// 0 = one per core
+///		"seconds": 4.0,			// default length, one sequencer loop if omitted
+///		"samples": [ "kick.wav" ],	// extra samples every job can use
+///		"jobs": [
+///			{
+///				"project": "patch.syn",
+///				"seconds": 2.0,
+///				"start": 8,		// bar to start playing from, 0 if omitted
+///				"midi": "song.mid",	// performance for the project's MIDI nodes
+///				"stems": [ 3, "bass" ],	// node outputs to write too, by index or label
+///				"parallel": true,	// split a long render across threads, no stems
+///				"overrides": [ { "node": 0, "param": "frequency", "value": 440 } ],
+///				"sweep": { "node": 2, "param": "cutOff", "values": [ 200, 800, 3200 ] }
+///			}
+///		]
+///	}
+///
+/// "node" is the index in the project's "nodes" array and "param" a key
+/// written by that node's save(). A sweep expands into one job per value.
+/// Job i is written to <output>/<i>.wav, numbered from 1 with four digits.
+/// Its stems go next to it, all from the same pass, named after the node's
+/// label (if referred to by it) and index, e.g. <output>/0001-bass-3.wav.
+/// A MIDI job without "seconds" lasts until its last event plus TWEN_BATCH_MIDI_TAIL.
+/// The file drives the project's MidiReceiver nodes directly; no job touches
+/// the editor's live MIDI input, so jobs can build their graphs side by side.
+/// A "parallel" job goes through Renderer::renderParallel, with its share of "threads".
+class BatchRenderer {
+public:
+	bool load(const Str& manifestFile);
+
+	/// Renders every job, then writes summary.json. Returns the number of failed jobs.
+	u32 run();
+
+	u32 jobCount() const { return u32(m_jobs.size()); }
+
+private:
+	struct Job {
+		Str project, file, midi;
+		JSON overrides, stems;
+		Vec<Str> stemFiles;
+		double seconds, start;
+		bool parallel;
+
+		// Results
+		bool ok{ false };
+		Str error;
+		u64 frames{ 0 };
+		float peak{ 0.0f }, rms{ 0.0f };
+		double renderMs{ 0.0 };
+	};
+
+	// Loaded once and shared by every job of the project
+	struct Project {
+		JSON document;
+		NodeGraph samples;
+	};
+
+	Str m_output;
+	float m_sampleRate{ 44100.0f };
+	u32 m_format{ 16 }, m_threads{ 0 };
+	/// Workers of each "parallel" job, set by run().
+	u32 m_jobThreads{ 1 };
+
+	NodeGraph m_samples;
+	Map<Str, Ptr<Project>> m_projects;
+	Vec<Job> m_jobs;
+
+	void render(Job& job);
+	void writeSummary();
+};
+
+#endif // TWEN_BATCH_RENDERER_H
@@ -0,0 +1,160 @@
+#include "FusedKernel.h"
+
+#include "intern/Utils.h"
+#include "nodes/MathNode.hpp"
+
+#include <algorithm>
+
+namespace {
+	/// Registers an instruction reads.
+	u32 arity(FusedKernel::Op op) {
+		switch (op) {
+			case FusedKernel::Load: return 0;
+			case FusedKernel::Math: return 2;
+			case FusedKernel::Lerp: return 3;
+			case FusedKernel::Remap: return 5;
+			case FusedKernel::NoteFrequency: return 1;
+			case FusedKernel::Store: return 1;
+		}
+		return 0;
+	}
+}
+
+void FusedKernel::run() {
+	float* r = m_regs.data();
+	for (const Instr& in : m_code) {
+		const u16* a = in.args;
+		switch (in.op) {
+			case Load: r[in.dst] = *in.src; break;
+			case Math: {
+				float x = r[a[0]], y = r[a[1]], v = 0.0f;
+				switch (*static_cast<const MathNode::MathOp*>(in.mode)) {
+					case MathNode::Add: v = x + y; break;
+					case MathNode::Sub: v = x - y; break;
+					case MathNode::Mul: v = x * y; break;
+					case MathNode::Neg: v = -x; break;
+					case MathNode::Average: v = (x + y) * 0.5f; break;
+					default: break;
+				}
+				r[in.dst] = v;
+			} break;
+			case Lerp: r[in.dst] = Utils::lerp(r[a[0]], r[a[1]], r[a[2]]); break;
+			case Remap: r[in.dst] = Utils::remap(r[a[0]], r[a[1]], r[a[2]], r[a[3]], r[a[4]]); break;
+			case NoteFrequency: r[in.dst] = Utils::noteFrequency(int(r[a[0]])); break;
+			case Store: *in.out = Value(r[a[0]]); break;
+		}
+	}
+}
+
+u16 KernelBuilder::newRegister() {
+	m_kernel.m_regs.push_back(0.0f);
+	return u16(m_kernel.m_regs.size() - 1);
+}
+
+u16 KernelBuilder::input(u32 slot) {
+	auto conn = m_inputs.find(slot);
+	if (conn != m_inputs.end()) {
+		auto reg = m_outputs.find(conn->second->from);
+		if (reg != m_outputs.end()) return reg->second;
+		return param(&conn->second->from->m_lastSample.value);
+	}
+	// Unconnected, or fed through a delayed connection (copied in beforehand)
+	return param(&m_node->in(slot).data.value);
+}
+
+u16 KernelBuilder::param(const float* value) {
+	FusedKernel::Instr in{};
+	in.op = FusedKernel::Load;
+	in.dst = newRegister();
+	in.src = value;
+	m_kernel.m_code.push_back(in);
+	return in.dst;
+}
+
+u16 KernelBuilder::op(FusedKernel::Op op, u16 a, u16 b, u16 c, u16 d, u16 e) {
+	FusedKernel::Instr in{};
+	in.op = op;
+	in.dst = newRegister();
+	in.args[0] = a; in.args[1] = b; in.args[2] = c; in.args[3] = d; in.args[4] = e;
+	m_kernel.m_code.push_back(in);
+	return in.dst;
+}
+
+u16 KernelBuilder::math(const void* mode, u16 a, u16 b) {
+	u16 dst = op(FusedKernel::Math, a, b);
+	m_kernel.m_code.back().mode = mode;
+	return dst;
+}
+
+void KernelBuilder::output(u16 reg) {
+	m_output = reg;
+	m_hasOutput = true;
+}
+
+bool KernelBuilder::add(Node* node, const Vec<Connection*>& inputs) {
+	m_node = node;
+	m_hasOutput = false;
+	m_inputs.clear();
+	for (Connection* conn : inputs) {
+		m_inputs[conn->toSlot] = conn;
+	}
+
+	const size_t code = m_kernel.m_code.size(), regs = m_kernel.m_regs.size();
+	if (!node->fuse(*this) || !m_hasOutput) {
+		m_kernel.m_code.resize(code);
+		m_kernel.m_regs.resize(regs);
+		return false;
+	}
+
+	m_outputs[node] = m_output;
+	m_kernel.m_nodes.push_back(node);
+
+	// Other nodes, feedback edges and the editor read this. Storing it right
+	// away keeps the register free for reuse
+	FusedKernel::Instr in{};
+	in.op = FusedKernel::Store;
+	in.args[0] = m_output;
+	in.out = &node->m_lastSample;
+	m_kernel.m_code.push_back(in);
+	return true;
+}
+
+void KernelBuilder::finish() {
+	Vec<FusedKernel::Instr>& code = m_kernel.m_code;
+
+	const u32 none = u32(-1);
+	Vec<u32> lastUse(m_kernel.m_regs.size(), none);
+	for (u32 i = 0; i < code.size(); i++) {
+		for (u32 a = 0; a < arity(code[i].op); a++) lastUse[code[i].args[a]] = i;
+	}
+
+	Vec<u16> phys(m_kernel.m_regs.size(), 0), free;
+	u16 count = 0;
+	for (u32 i = 0; i < code.size(); i++) {
+		FusedKernel::Instr& in = code[i];
+		const u32 n = arity(in.op);
+
+		// Operands first, so the result can take the place of one that dies here
+		for (u32 a = 0; a < n; a++) {
+			const u16 v = in.args[a];
+			in.args[a] = phys[v];
+			if (lastUse[v] == i && std::find(in.args, in.args + a, phys[v]) == in.args + a) {
+				free.push_back(phys[v]);
+			}
+		}
+
+		if (in.op == FusedKernel::Store) continue;
+
+		const u16 v = in.dst;
+		if (free.empty()) {
+			phys[v] = count++;
+		} else {
+			phys[v] = free.back();
+			free.pop_back();
+		}
+		in.dst = phys[v];
+		if (lastUse[v] == none) free.push_back(phys[v]);
+	}
+
+	m_kernel.m_regs.assign(count, 0.0f);
+}
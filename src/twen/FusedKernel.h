@@ -0,0 +1,87 @@
+#ifndef TWEN_FUSED_KERNEL_H
+#define TWEN_FUSED_KERNEL_H
+
+#include "Node.h"
+
+/// A run of stateless nodes compiled into one flat program over float
+/// registers: no virtual calls and no Value temporaries between the nodes.
+/// Node parameters are read through pointers, so knob changes apply without
+/// recompiling; only connecting/disconnecting rebuilds it.
+class FusedKernel {
+public:
+	enum Op : u8 {
+		Load = 0, ///< r = *src
+		Math, ///< r = a (MathNode::MathOp *mode) b
+		Lerp, ///< r = a + (b - a) * c
+		Remap, ///< Utils::remap(a, b, c, d, e)
+		NoteFrequency, ///< Utils::noteFrequency(int(a))
+		Store ///< *out = Value(a)
+	};
+
+	struct Instr {
+		Op op;
+		u16 dst;
+		u16 args[5];
+		const float* src;
+		/// A MathNode::MathOp, the header can't name it.
+		const void* mode;
+		Value* out;
+	};
+
+	/// Evaluates the whole run for the current sample.
+	void run();
+
+	u32 size() const { return u32(m_code.size()); }
+	u32 registers() const { return u32(m_regs.size()); }
+	const Vec<Node*>& nodes() const { return m_nodes; }
+
+private:
+	Vec<Instr> m_code;
+	Vec<float> m_regs;
+	Vec<Node*> m_nodes;
+
+	friend class KernelBuilder;
+};
+
+/// Handed to Node::fuse() to lower one node into a FusedKernel.
+class KernelBuilder {
+public:
+	/// Register holding input slot of the node being lowered.
+	u16 input(u32 slot);
+
+	/// Register loaded from a node parameter, every sample.
+	u16 param(const float* value);
+
+	u16 op(FusedKernel::Op op, u16 a, u16 b = 0, u16 c = 0, u16 d = 0, u16 e = 0);
+	/// mode points to a MathNode::MathOp.
+	u16 math(const void* mode, u16 a, u16 b);
+
+	/// The node's output.
+	void output(u16 reg);
+
+private:
+	friend class NodeGraph;
+
+	FusedKernel& m_kernel;
+	Node* m_node{ nullptr };
+	u16 m_output{ 0 };
+	bool m_hasOutput{ false };
+
+	// Output registers of the nodes already in the kernel
+	UMap<Node*, u16> m_outputs;
+	// Non delayed connections into the current node, by slot
+	UMap<u32, Connection*> m_inputs;
+
+	KernelBuilder(FusedKernel& kernel) : m_kernel(kernel) {}
+
+	u16 newRegister();
+
+	/// Lowers one node, false if it cannot be fused (nothing is emitted then).
+	bool add(Node* node, const Vec<Connection*>& inputs);
+	/// Register allocation: maps the one-register-per-value program onto as
+	/// few registers as possible, reusing each one once its value is dead
+	/// (in place when an operand dies at the instruction that writes).
+	void finish();
+};
+
+#endif // TWEN_FUSED_KERNEL_H
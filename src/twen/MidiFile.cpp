@@ -0,0 +1,190 @@
+#include "MidiFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+#include "intern/Log.h"
+
+// Microseconds per quarter note until the first tempo event (120 bpm)
+#define TWEN_MIDI_DEFAULT_TEMPO 500000
+
+namespace {
+	/// Big-endian reads that stop at the end of the data.
+	struct ByteReader {
+		const u8* data;
+		size_t size, pos{ 0 };
+		bool ok{ true };
+
+		bool more() const { return ok && pos < size; }
+
+		u8 byte() {
+			if (pos >= size) { ok = false; return 0; }
+			return data[pos++];
+		}
+
+		u32 be(u32 bytes) {
+			u32 v = 0;
+			for (u32 i = 0; i < bytes; i++) v = (v << 8) | byte();
+			return v;
+		}
+
+		/// Variable length quantity, at most four bytes.
+		u32 vlq() {
+			u32 v = 0;
+			for (u32 i = 0; i < 4; i++) {
+				const u8 b = byte();
+				v = (v << 7) | (b & 0x7F);
+				if ((b & 0x80) == 0) return v;
+			}
+			ok = false;
+			return v;
+		}
+
+		void skip(size_t n) {
+			if (n > size - pos) { ok = false; pos = size; return; }
+			pos += n;
+		}
+	};
+}
+
+bool MidiFile::open(const Str& fileName) {
+	std::ifstream fp(fileName, std::ios::binary);
+	if (!fp.good()) {
+		LogE("Could not open MIDI file: ", fileName);
+		return false;
+	}
+
+	Vec<u8> data((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+	if (!parse(data.data(), data.size())) {
+		LogE("Invalid MIDI file: ", fileName);
+		return false;
+	}
+	return true;
+}
+
+bool MidiFile::parse(const u8* data, size_t size) {
+	m_events.clear();
+	m_tempo.clear();
+	m_endTick = 0;
+	m_tracks = 0;
+
+	ByteReader r{ data, size };
+	if (r.be(4) != 0x4D546864) return false; // "MThd"
+	const u32 headerLength = r.be(4);
+	if (headerLength < 6) return false;
+
+	const u32 format = r.be(2), tracks = r.be(2), division = r.be(2);
+	r.skip(headerLength - 6);
+	if (!r.ok) return false;
+	if (format > 1) {
+		LogE("Only MIDI files of format 0 and 1 are supported.");
+		return false;
+	}
+
+	if (division & 0x8000) {
+		// Frames per second (29 is 29.97 drop frame) times ticks per frame
+		const int fps = -int(i8(division >> 8));
+		m_division = (fps == 29 ? 29.97 : double(fps)) * double(division & 0xFF);
+		m_smpte = true;
+	} else {
+		m_division = double(division);
+		m_smpte = false;
+	}
+	if (m_division <= 0.0) return false;
+
+	while (m_tracks < tracks && r.more()) {
+		const u32 id = r.be(4), length = r.be(4);
+		if (!r.ok || length > r.size - r.pos) return false;
+		// Unknown chunks are skipped, as the format asks
+		if (id == 0x4D54726B) { // "MTrk"
+			if (!parseTrack(r.data + r.pos, length)) return false;
+			m_tracks++;
+		}
+		r.skip(length);
+	}
+
+	// Merged by time, events at the same tick keep their file order
+	std::stable_sort(m_events.begin(), m_events.end(), [](const TickEvent& a, const TickEvent& b) {
+		return a.tick < b.tick;
+	});
+
+	std::stable_sort(m_tempo.begin(), m_tempo.end(), [](const Tempo& a, const Tempo& b) { return a.tick < b.tick; });
+	if (m_tempo.empty() || m_tempo[0].tick > 0) {
+		m_tempo.insert(m_tempo.begin(), { 0, TWEN_MIDI_DEFAULT_TEMPO, 0.0 });
+	}
+	for (size_t i = 1; i < m_tempo.size(); i++) {
+		const Tempo& prev = m_tempo[i - 1];
+		m_tempo[i].start = prev.start + double(m_tempo[i].tick - prev.tick) * double(prev.usPerQuarter) / (1e6 * m_division);
+	}
+	return true;
+}
+
+bool MidiFile::parseTrack(const u8* data, size_t size) {
+	ByteReader r{ data, size };
+	u64 tick = 0;
+	u8 running = 0;
+
+	while (r.more()) {
+		tick += r.vlq();
+
+		u8 status = r.byte();
+		u8 data0;
+		if (status < 0x80) {
+			// Running status: the byte was the first data byte
+			if (running == 0) return false;
+			data0 = status;
+			status = running;
+		} else if (status < 0xF0) {
+			running = status;
+			data0 = r.byte();
+		} else if (status == 0xFF) {
+			const u8 type = r.byte();
+			const u32 length = r.vlq();
+			if (type == 0x51 && length == 3) {
+				m_tempo.push_back({ tick, r.be(3), 0.0 });
+			} else {
+				r.skip(length);
+			}
+			if (type == 0x2F) break; // End of track
+			continue;
+		} else if (status == 0xF0 || status == 0xF7) {
+			running = 0;
+			r.skip(r.vlq());
+			continue;
+		} else {
+			// System common/real-time messages don't belong in files
+			return false;
+		}
+
+		// Program change and channel pressure have one data byte
+		const u8 command = status >> 4;
+		const u8 data1 = (command == 0xC || command == 0xD) ? 0 : r.byte();
+		if (!r.ok) return false;
+		m_events.push_back({ tick, status, u8(data0 & 0x7F), u8(data1 & 0x7F) });
+	}
+
+	if (!r.ok) return false;
+	m_endTick = std::max(m_endTick, tick);
+	return true;
+}
+
+double MidiFile::secondsAt(u64 tick) const {
+	if (m_smpte) return double(tick) / m_division;
+	if (m_tempo.empty()) return 0.0;
+
+	auto pos = std::upper_bound(m_tempo.begin() + 1, m_tempo.end(), tick, [](u64 t, const Tempo& tempo) { return t < tempo.tick; });
+	const Tempo& t = *(pos - 1);
+	return t.start + double(tick - t.tick) * double(t.usPerQuarter) / (1e6 * m_division);
+}
+
+Vec<MidiEvent> MidiFile::events(float sampleRate) const {
+	Vec<MidiEvent> ret;
+	ret.reserve(m_events.size());
+	for (const TickEvent& e : m_events) {
+		const u64 frame = u64(std::llround(secondsAt(e.tick) * double(sampleRate)));
+		ret.push_back({ frame, e.status, e.data0, e.data1 });
+	}
+	return ret;
+}
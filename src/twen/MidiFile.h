@@ -0,0 +1,66 @@
+#ifndef TWEN_MIDI_FILE_H
+#define TWEN_MIDI_FILE_H
+
+#include "intern/Utils.h"
+
+/// A channel message (note on/off, controller, ...) at an engine sample.
+struct MidiEvent {
+	u64 frame;
+	u8 status, data0, data1;
+
+	u8 command() const { return status >> 4; }
+	u8 channel() const { return status & 0xF; }
+};
+
+/// Nodes that play MIDI, so offline renders can drive them (see Renderer::midi).
+class MidiReceiver {
+public:
+	virtual ~MidiReceiver() = default;
+
+	/// The channel listened to, -1 for all of them.
+	virtual int midiChannel() = 0;
+	virtual void midiEvent(const MidiEvent& event) = 0;
+};
+
+/// Reads Standard MIDI Files (formats 0 and 1). Every track is merged into
+/// one stream of channel messages; meta events other than tempo changes and
+/// system exclusive messages are dropped.
+class MidiFile {
+public:
+	bool open(const Str& fileName);
+	bool parse(const u8* data, size_t size);
+
+	/// The events, timed in samples at sampleRate through the file's tempo map.
+	Vec<MidiEvent> events(float sampleRate) const;
+
+	/// Up to the last event (or end of track), in seconds.
+	double length() const { return secondsAt(m_endTick); }
+
+	u32 tracks() const { return m_tracks; }
+
+private:
+	struct TickEvent {
+		u64 tick;
+		u8 status, data0, data1;
+	};
+
+	struct Tempo {
+		u64 tick;
+		u32 usPerQuarter;
+		/// Where the tick falls, in seconds.
+		double start;
+	};
+
+	Vec<TickEvent> m_events;
+	Vec<Tempo> m_tempo;
+	u64 m_endTick{ 0 };
+	u32 m_tracks{ 0 };
+	// Ticks per quarter note, or per second for SMPTE time
+	double m_division{ 480.0 };
+	bool m_smpte{ false };
+
+	bool parseTrack(const u8* data, size_t size);
+	double secondsAt(u64 tick) const;
+};
+
+#endif // TWEN_MIDI_FILE_H
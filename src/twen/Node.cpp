@@ -4,28 +4,45 @@
 
 #include "NodeGraph.h"
 
+#include <atomic>
+
 Node::Node()
- :	m_solved(false),
+ :	m_inputCount(0),
 	m_bufferPos(0),
 	m_type(Utils::getTypeIndex<Node>()),
+	m_kind(0),
+	m_traits(0),
 	m_lastSample(Value())
 {
-	m_buffer.fill(0.0f);
 }
 
-void Node::addInput(const Str& name, float def) {
-	m_inputs.push_back(NodeInput(def));
-	m_inputNames.push_back(name);
+NodeKind Node::newKind() {
+	static std::atomic<NodeKind> next{ 1 };
+	return next++;
+}
+
+void Node::addInput(const char* name, float def) {
+	LogAssert(m_inputCount < TWEN_NODE_MAX_INPUTS, "Too many inputs, raise TWEN_NODE_MAX_INPUTS.");
+	m_inputs[m_inputCount] = NodeInput(def);
+	m_inputNames[m_inputCount] = name;
+	m_inputCount++;
 }
 
 void Node::updateBuffer(float val) {
-	m_buffer[m_bufferPos++ % TWEN_NODE_BUFFER_SIZE] = val;
+	if (m_buffer == nullptr) return;
+	(*m_buffer)[m_bufferPos++ % TWEN_NODE_BUFFER_SIZE] = val;
+}
+
+const Arr<float, TWEN_NODE_BUFFER_SIZE>& Node::buffer() const {
+	static const Arr<float, TWEN_NODE_BUFFER_SIZE> silence{};
+	return m_buffer != nullptr ? *m_buffer : silence;
 }
 
 void Node::save(JSON& json) {
 	json["type"] = typeName();
+	if (!m_label.empty()) json["label"] = m_label;
 }
 
-void Node::load(JSON json) {
-
+void Node::load(const JSON& json) {
+	m_label = json.value("label", Str());
 }
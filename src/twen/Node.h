@@ -3,6 +3,7 @@
 
 #include "intern/Utils.h"
 #include "intern/Vector.h"
+#include "intern/State.h"
 
 #include <initializer_list>
 #include <vector>
@@ -10,14 +11,27 @@
 #define STR(x) #x
 #define TWEN_NODE(x, title) public: static Str type() { return STR(x); } \
 									static TypeIndex typeID() { return Utils::getTypeIndex<x>(); } \
+									static NodeKind kind() { static const NodeKind k = Node::newKind(); return k; } \
 									static Str prettyName() { return title; }
 
 #define TWEN_NODE_BUFFER_SIZE 256
+#define TWEN_NODE_MAX_INPUTS 4
+
+// Signals below this (about -100 dB) count as silence
+#define TWEN_SILENCE 1e-5f
+
+/// Dense integer id of a node type, usable as a table index. 0 means unknown.
+using NodeKind = u32;
 
 class Node;
 struct Connection {
 	Node *from, *to;
 	u32 toSlot;
+
+	/// Marked by the user: "to" reads what "from" produced one sample earlier.
+	bool feedback{ false };
+	/// Set by the graph compiler: explicit feedback, or the edge it picked to break a cycle.
+	bool delayed{ false };
 };
 
 struct Value {
@@ -27,6 +41,9 @@ struct Value {
 	Value(float val = 0.0f, float vel = 1.0f, bool gate = true)
 		: value(val), velocity(vel), gate(gate)
 	{}
+
+	bool operator==(const Value& o) const { return value == o.value && velocity == o.velocity && gate == o.gate; }
+	bool operator!=(const Value& o) const { return !(*this == o); }
 };
 
 struct NodeInput {
@@ -42,50 +59,119 @@ struct NodeInput {
 };
 
 class NodeGraph;
+class KernelBuilder;
+class PatchExporter;
 class Node {
 	friend class NodeGraph;
 	friend class NodeBuilder;
+	friend class KernelBuilder;
 
 	TWEN_NODE(Node, "Node")
 
 public:
+	/// Per-type properties, given to NodeBuilder::registerType.
+	enum Trait {
+		Sink = 1 << 0, ///< Solved even when nothing reads it (output, storage writers)
+		Stateless = 1 << 1, ///< The output only depends on the current inputs
+		ControlRate = 1 << 2, ///< Changes with events (notes, knobs), not every sample
+		Resettable = 1 << 3, ///< Has playback state, cleared by reset()
+		ReadsStorage = 1 << 4,
+		WritesStorage = 1 << 5
+	};
+
 	Node();
 
 	virtual Value sample(NodeGraph *graph) { return 0.0f; }
 
+	/// Back to the start of playback, for Resettable nodes.
+	virtual void reset() {}
+
+	/// Lowers a Stateless node into a FusedKernel, see KernelBuilder.
+	/// False if the node can only be evaluated through sample().
+	virtual bool fuse(KernelBuilder& kb) { return false; }
+
+	/// Describes the parameters to a PatchExporter.
+	/// False if the type cannot be exported.
+	virtual bool exportParams(PatchExporter& ex) { return false; }
+
+	/// True when the node has come to rest (envelope idle, sample stopped,
+	/// delay rung out): its output is silent and stays so as long as its inputs
+	/// don't change. The graph then skips it, outputting 0, until one does.
+	virtual bool settled() const { return false; }
+
+	/// False when the output depends on more than the inputs, the parameters
+	/// and the transport (noise, random arpeggios, live input), so a loop of
+	/// it can't be frozen (see NodeGraph::freeze).
+	virtual bool deterministic() const { return true; }
+
+	/// What sample() changes as it runs (phases, envelopes, delay buffers),
+	/// as opposed to the parameters save() writes. restoreState reads it back
+	/// into a node of the same type and parameters. The graph takes care of
+	/// the inputs and the last output.
+	virtual void saveState(StateWriter& w) const {}
+	virtual void restoreState(StateReader& r) {}
+
 	virtual void save(JSON& json);
-	virtual void load(JSON json);
+	virtual void load(const JSON& json);
 
 	bool connected(u32 i) const { return m_inputs[i].connected; }
 	NodeInput& in(u32 i) { return m_inputs[i]; }
 
-	Vec<NodeInput> inputs() const { return m_inputs; }
-	Vec<Str> inNames() const { return m_inputNames; }
+	u32 inputCount() const { return m_inputCount; }
+	const char* inName(u32 i) const { return m_inputNames[i]; }
+
+	Vec<NodeInput> inputs() const { return Vec<NodeInput>(m_inputs.begin(), m_inputs.begin() + m_inputCount); }
+	Vec<Str> inNames() const { return Vec<Str>(m_inputNames.begin(), m_inputNames.begin() + m_inputCount); }
 
 	Str name() const { return m_name; }
 	Str typeName() const { return m_typeName; }
+
+	/// Given by the user to find the node again (e.g. a stem to render), saved with it.
+	const Str& label() const { return m_label; }
+	void label(const Str& label) { m_label = label; }
+
+	/// What the node put out on the last sample.
+	const Value& output() const { return m_lastSample; }
+
 	TypeIndex getType() const { return m_type; }
+	NodeKind getKind() const { return m_kind; }
+	u32 traits() const { return m_traits; }
+	bool is(Trait trait) const { return (m_traits & trait) != 0; }
+
+	/// Next free kind id, see TWEN_NODE.
+	static NodeKind newKind();
 
-	Arr<float, TWEN_NODE_BUFFER_SIZE> buffer() { return m_buffer; }
+	/// The last TWEN_NODE_BUFFER_SIZE samples, for scopes. Only Sink nodes keep
+	/// them, everything else reads as silence.
+	const Arr<float, TWEN_NODE_BUFFER_SIZE>& buffer() const;
 
 	NodeGraph* graph() { return m_graph; }
 
 protected:
-	Str m_name, m_typeName;
+	Str m_name, m_typeName, m_label;
 	TypeIndex m_type;
+	NodeKind m_kind;
+	u32 m_traits;
 
 	NodeGraph *m_graph;
 
-	Vec<Str> m_inputNames;
-	Vec<NodeInput> m_inputs;
+	// Inline, so reading an input doesn't leave the node. The names are the
+	// literals given to addInput, shared by every instance of a type
+	Arr<NodeInput, TWEN_NODE_MAX_INPUTS> m_inputs;
+	Arr<const char*, TWEN_NODE_MAX_INPUTS> m_inputNames;
+	u32 m_inputCount;
 
-	Arr<float, TWEN_NODE_BUFFER_SIZE> m_buffer;
+	// Allocated by NodeBuilder for Sink nodes, so the rest of the graph
+	// doesn't drag 1 KB per node through the cache every sample
+	Ptr<Arr<float, TWEN_NODE_BUFFER_SIZE>> m_buffer;
 	u32 m_bufferPos;
 
-	bool m_solved;
 	Value m_lastSample;
+	// Skipped by the graph, see settled()
+	bool m_asleep{ false };
 
-	void addInput(const Str& name, float def = 0.0f);
+	/// name must be a string literal (or otherwise outlive the node).
+	void addInput(const char* name, float def = 0.0f);
 	void updateBuffer(float val);
 };
 
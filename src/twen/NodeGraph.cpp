@@ -1,25 +1,177 @@
 #include "NodeGraph.h"
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <fstream>
 
 #include "TAudio.h"
+#include "intern/Resampler.h"
 #include "nodes/StorageNodes.hpp"
 
 #include "Node.h"
 #include "nodes/OutNode.hpp"
 
 NodeGraph::NodeGraph()
-	: m_gain(1.0f), m_time(0.0f),
+	: m_gain(1.0f),
 	  m_sampleRate(44100.0f), m_bpm(120.0f),
 	  m_outputNode(nullptr),
-	  m_bars(4), m_noteIndex(0)
+	  m_bars(4)
 {
 	m_globalStorage.fill(Value());
+	m_tempo.push_back({ 0.0, m_bpm });
+	retime();
+	locate(0);
+	m_schedule = new Schedule();
+}
+
+NodeGraph::~NodeGraph() {
+	delete m_schedule;
+	delete m_next.exchange(nullptr);
+	delete m_retired.exchange(nullptr);
 }
 
 float NodeGraph::time() {
-	return m_time / delay();
+	return float(double(m_position - m_stepStart) / double(m_stepEnd - m_stepStart));
+}
+
+void NodeGraph::bpm(float bpm) {
+	const double at = bar();
+	m_bpm = bpm;
+	m_tempo[0].bpm = bpm;
+	retime();
+	locate(frameAt(at));
+}
+
+void NodeGraph::tempoChange(double bar, float bpm) {
+	if (bar <= 0.0) {
+		this->bpm(bpm);
+		return;
+	}
+
+	const double at = this->bar();
+	auto pos = std::lower_bound(m_tempo.begin(), m_tempo.end(), bar, [](const TempoChange& t, double b) { return t.bar < b; });
+	if (pos != m_tempo.end() && pos->bar == bar) {
+		pos->bpm = bpm;
+	} else {
+		m_tempo.insert(pos, { bar, bpm });
+	}
+	retime();
+	locate(frameAt(at));
+}
+
+void NodeGraph::clearTempoChanges() {
+	const double at = bar();
+	m_tempo.resize(1);
+	retime();
+	locate(frameAt(at));
+}
+
+void NodeGraph::loop(double start, double end) {
+	m_loopFrom = std::max(start, 0.0);
+	m_loopTo = end;
+	retime();
+}
+
+void NodeGraph::retime() {
+	for (size_t i = 1; i < m_tempo.size(); i++) {
+		const TempoChange& prev = m_tempo[i - 1];
+		m_tempo[i].start = prev.start + (m_tempo[i].bar - prev.bar) * 60.0 / double(prev.bpm) * double(m_sampleRate);
+	}
+
+	if (m_loopTo > m_loopFrom) {
+		m_loopStartFrame = frameAt(m_loopFrom);
+		m_loopEndFrame = frameAt(m_loopTo);
+	} else {
+		m_loopStartFrame = m_loopEndFrame = 0;
+	}
+}
+
+void NodeGraph::loadTransport(const JSON& project) {
+	bpm(project.value("bpm", 120.0f));
+	bars(project.value("bars", 4));
+
+	clearTempoChanges();
+	auto tempo = project.find("tempo");
+	if (tempo != project.end() && tempo->is_array()) {
+		for (const JSON& t : *tempo) {
+			tempoChange(t[0].get<double>(), t[1].get<float>());
+		}
+	}
+
+	auto region = project.find("loop");
+	if (region != project.end() && region->is_array() && region->size() == 2) {
+		loop((*region)[0].get<double>(), (*region)[1].get<double>());
+	} else {
+		loop(0.0, 0.0);
+	}
+}
+
+void NodeGraph::saveTransport(JSON& project) const {
+	project["bpm"] = m_bpm;
+	project["bars"] = m_bars;
+
+	if (m_tempo.size() > 1) {
+		JSON tempo = JSON::array();
+		for (size_t i = 1; i < m_tempo.size(); i++) {
+			tempo.push_back({ m_tempo[i].bar, m_tempo[i].bpm });
+		}
+		project["tempo"] = tempo;
+	}
+	if (m_loopTo > m_loopFrom) {
+		project["loop"] = { m_loopFrom, m_loopTo };
+	}
+}
+
+double NodeGraph::sampleAt(double bar) const {
+	auto pos = std::upper_bound(m_tempo.begin() + 1, m_tempo.end(), bar, [](double b, const TempoChange& t) { return b < t.bar; });
+	const TempoChange& t = *(pos - 1);
+	return t.start + (bar - t.bar) * 60.0 / double(t.bpm) * double(m_sampleRate);
+}
+
+double NodeGraph::barAt(double sample) const {
+	auto pos = std::upper_bound(m_tempo.begin() + 1, m_tempo.end(), sample, [](double s, const TempoChange& t) { return s < t.start; });
+	const TempoChange& t = *(pos - 1);
+	return t.bar + (sample - t.start) * double(t.bpm) / (60.0 * double(m_sampleRate));
+}
+
+u64 NodeGraph::frameAt(double bar) const {
+	// Rounding errors must not push a position that falls on a sample to the next one
+	const double sample = sampleAt(bar);
+	return sample <= 0.0 ? 0 : u64(std::ceil(sample - 1e-6));
+}
+
+void NodeGraph::locate(u64 sample) {
+	m_position = sample;
+
+	u64 step = u64(std::max(std::floor(barAt(double(sample)) * 4.0), 0.0));
+	while (step > 0 && stepFrame(step) > sample) step--;
+	while (stepFrame(step + 1) <= sample) step++;
+
+	m_step = step;
+	m_stepStart = stepFrame(step);
+	m_stepEnd = stepFrame(step + 1);
+}
+
+void NodeGraph::seek(u64 sample) {
+	locate(sample);
+
+	// The recorded loops only line up again from the start of the pattern
+	const bool patternStart = index() == 0 && m_position == m_stepStart;
+	for (auto&& freeze : m_schedule->freezes) {
+		if (freeze->state == Freeze::Playing) {
+			if (patternStart) {
+				freeze->pos = 0;
+			} else {
+				freeze->state = Freeze::Waiting;
+				freeze->loop.clear();
+				m_dirty = true;
+			}
+		} else if (freeze->state != Freeze::Failed) {
+			freeze->state = Freeze::Waiting;
+			if (patternStart) loopStart(*freeze);
+		}
+	}
 }
 
 Node* NodeGraph::add(Node *node) {
@@ -27,9 +179,10 @@ Node* NodeGraph::add(Node *node) {
 
 	node->m_graph = this;
 	m_nodes.push_back(Ptr<Node>(node));
-	if (node->getType() == OutNode::typeID()) {
+	if (node->getKind() == OutNode::kind()) {
 		m_outputNode = m_nodes.back().get();
 	}
+	m_dirty = true;
 	return m_nodes.back().get();
 }
 
@@ -61,7 +214,14 @@ void NodeGraph::remove(Node *node) {
 			m_connections.erase(m_connections.begin() + idx);
 		}
 
+		auto freeze = std::find_if(m_freezes.begin(), m_freezes.end(), [&](const std::shared_ptr<Freeze>& f) { return f->node == node; });
+		if (freeze != m_freezes.end()) m_freezes.erase(freeze);
+
+		if (node == m_outputNode) m_outputNode = nullptr;
+		// The schedule being played may still run it
+		m_removed.push_back(std::move(*pos));
 		m_nodes.erase(pos);
+		m_dirty = true;
 	}
 }
 
@@ -93,6 +253,7 @@ Connection* NodeGraph::connect(Node *from, Node *to, u32 slot) {
 	m_connections.push_back(Ptr<Connection>(conn));
 
 	to->m_inputs[slot].connected = true;
+	m_dirty = true;
 
 	return m_connections.back().get();
 }
@@ -111,132 +272,751 @@ void NodeGraph::disconnect(Connection *conn) {
 	if (pos != m_connections.end()) {
 		conn->to->m_inputs[conn->toSlot].connected = false;
 		m_connections.erase(pos);
+		m_dirty = true;
 	}
 }
 
-float NodeGraph::sample() {
+NodeGraph::Schedule* NodeGraph::compile() {
+	// Cleanup
+	Vec<u32> toRemove;
+	for (u32 i = 0; i < m_connections.size(); i++) {
+		if (m_connections[i]->from == nullptr || m_connections[i]->to == nullptr) {
+			toRemove.push_back(i);
+		}
+	}
+	std::reverse(toRemove.begin(), toRemove.end());
+	for (u32 idx : toRemove) {
+		m_connections.erase(m_connections.begin() + idx);
+		LogI("Cleaned up invalid connection ", idx);
+	}
+
 	if (m_outputNode == nullptr) {
 		for (auto&& node : m_nodes) {
-			if (node->getType() == OutNode::typeID()) {
+			if (node->getKind() == OutNode::kind()) {
 				m_outputNode = node.get();
 				break;
 			}
 		}
 	}
 
-	// Reset
+	// Nodes that feed something, the sinks and the output are evaluated
+	UMap<Node*, Vec<Connection*>> inputs;
+	UMap<Node*, bool> active;
+	for (auto&& conn : m_connections) {
+		conn->delayed = conn->feedback;
+		inputs[conn->to].push_back(conn.get());
+		active[conn->from] = true;
+	}
+
+	// Depth-first, in node and connection order so the result only depends
+	// on the patch. An edge back into a node still being visited closes a
+	// cycle, and becomes delayed.
+	enum { Unvisited = 0, Visiting, Done };
+	UMap<Node*, u8> state;
+	Vec<Node*> order;
+
+	std::function<void(Node*)> visit = [&](Node* node) {
+		state[node] = Visiting;
+		for (Connection* conn : inputs[node]) {
+			if (conn->delayed) continue;
+			u8 from = state[conn->from];
+			if (from == Visiting) {
+				conn->delayed = true;
+			} else if (from == Unvisited) {
+				visit(conn->from);
+			}
+		}
+		state[node] = Done;
+		order.push_back(node);
+	};
+
 	for (auto&& node : m_nodes) {
-		node->m_solved = false;
+		if (node->is(Node::Sink) && state[node.get()] == Unvisited) visit(node.get());
+	}
+	if (m_outputNode != nullptr && state[m_outputNode] == Unvisited) visit(m_outputNode);
+	for (auto&& node : m_nodes) {
+		if (active[node.get()] && state[node.get()] == Unvisited) visit(node.get());
 	}
 
-	u32 i = 0;
-	Vec<u32> toRemove;
+	// Frozen subgraphs: what each one reads, and whether it can repeat at all
+	UMap<Node*, bool> skipped;
+	for (auto&& freeze : m_freezes) {
+		Freeze& f = *freeze;
+		f.nodes.clear();
+		// Read by sample() meanwhile, only stored once known
+		bool eligible = true;
+
+		UMap<Node*, bool> seen;
+		Vec<Node*> stack{ f.node };
+		seen[f.node] = true;
+		while (!stack.empty()) {
+			Node* node = stack.back();
+			stack.pop_back();
+			f.nodes.push_back(node);
+			if (!node->deterministic() || node->is(Node::ReadsStorage) || node->is(Node::WritesStorage)) {
+				eligible = false;
+			}
+			for (Connection* conn : inputs[node]) {
+				if (!seen[conn->from]) {
+					seen[conn->from] = true;
+					stack.push_back(conn->from);
+				}
+			}
+		}
+
+		// sample() compares it with the one taken when the loop was recorded
+		f.current = hashOf(f);
+		f.eligible = eligible;
+		// Fails when the loop starts, tried again when the subgraph changes
+		if (!eligible) continue;
+		if (f.state != Freeze::Playing) continue;
+
+		// While the loop plays, the nodes that only feed it are not needed
+		UMap<Node*, bool> inside;
+		inside[f.node] = true;
+		bool grew = true;
+		while (grew) {
+			grew = false;
+			for (Node* node : f.nodes) {
+				if (inside[node]) continue;
+				bool only = true;
+				for (auto&& conn : m_connections) {
+					if (conn->from == node && !inside[conn->to]) {
+						only = false;
+						break;
+					}
+				}
+				if (only) {
+					inside[node] = true;
+					skipped[node] = true;
+					grew = true;
+				}
+			}
+		}
+	}
+	if (!skipped.empty()) {
+		auto end = std::remove_if(order.begin(), order.end(), [&](Node* node) { return skipped[node]; });
+		order.erase(end, order.end());
+	}
+
+	Schedule* ret = new Schedule();
+	ret->output = m_outputNode;
+	ret->removed = std::move(m_removed);
+	m_removed.clear();
+
+	// Recording never allocates, the buffers are grown here for the tempo and length
+	const size_t capacity = loopCapacity();
+	for (auto&& freeze : m_freezes) {
+		ret->freezes.push_back(freeze);
+		ret->loops.emplace_back();
+		if (freeze->capacity < capacity) {
+			ret->loops.back().reserve(capacity);
+			freeze->capacity = capacity;
+		}
+	}
+
+	// Delayed inputs are read up front, everything else right before its node
 	for (auto&& conn : m_connections) {
-		// Cleanup
-		if (conn->from == nullptr || conn->to == nullptr) {
-			toRemove.push_back(i);
+		if (conn->delayed) ret->delayed.push_back({ &conn->to->in(conn->toSlot).data, &conn->from->m_lastSample, conn->to });
+	}
+	for (auto&& [node, conns] : inputs) {
+		auto end = std::remove_if(conns.begin(), conns.end(), [](Connection* c) { return c->delayed; });
+		conns.erase(end, conns.end());
+	}
+
+	schedule(*ret, order, inputs);
+	return ret;
+}
+
+void NodeGraph::schedule(Schedule& out, const Vec<Node*>& order, UMap<Node*, Vec<Connection*>>& inputs) {
+	out.nodes = order;
+
+	u32 i = 0;
+	while (i < order.size()) {
+		// A run of Stateless nodes, one after the other in the schedule
+		u32 end = i;
+		while (end < order.size() && order[end]->is(Node::Stateless) && findFreeze(order[end]) == nullptr) end++;
+
+		Ptr<FusedKernel> kernel;
+		if (end - i >= 2) {
+			kernel = Ptr<FusedKernel>(new FusedKernel());
+			KernelBuilder kb(*kernel);
+			u32 fused = i;
+			while (fused < end && kb.add(order[fused], inputs[order[fused]])) fused++;
+			// Anything left of the run stays a regular step
+			end = fused;
+			kb.finish();
+		}
+
+		Step step{};
+		if (end - i >= 2) {
+			step.kernel = kernel.get();
+			out.kernels.push_back(std::move(kernel));
+			i = end;
+		} else {
+			Node* node = order[i++];
+			step.node = node;
+			step.freeze = findFreeze(node);
+			step.first = u32(out.copies.size());
+			// A replayed node doesn't read its inputs
+			if (step.freeze == nullptr || step.freeze->state != Freeze::Playing) {
+				for (Connection* conn : inputs[node]) {
+					out.copies.push_back({ &node->in(conn->toSlot).data, &conn->from->m_lastSample, node });
+				}
+			}
+			step.count = u32(out.copies.size()) - step.first;
+		}
+		out.steps.push_back(step);
+	}
+}
+
+void NodeGraph::commit() {
+	delete m_retired.exchange(nullptr, std::memory_order_acq_rel);
+	if (!m_dirty.exchange(false)) {
+		// Edits don't tell the graph, sample() asks for the freezes to be checked
+		if (m_rehash.exchange(false)) {
+			for (auto&& freeze : m_freezes) freeze->current = hashOf(*freeze);
+		}
+		return;
+	}
+	m_rehash = false;
+
+	Schedule* next = compile();
+	// Never swapped in, so the nodes removed before it may still be running
+	// and the buffers grown for it are still needed
+	Schedule* stale = m_next.exchange(nullptr, std::memory_order_acq_rel);
+	if (stale != nullptr) {
+		for (auto&& node : stale->removed) next->removed.push_back(std::move(node));
+		for (size_t i = 0; i < stale->freezes.size(); i++) {
+			auto pos = std::find(next->freezes.begin(), next->freezes.end(), stale->freezes[i]);
+			if (pos == next->freezes.end()) continue;
+			Vec<Value>& loop = next->loops[pos - next->freezes.begin()];
+			if (loop.capacity() < stale->loops[i].capacity()) std::swap(loop, stale->loops[i]);
+		}
+		delete stale;
+	}
+	m_next.store(next, std::memory_order_release);
+}
+
+void NodeGraph::adopt() {
+	if (m_next.load(std::memory_order_acquire) == nullptr || m_retired.load(std::memory_order_acquire) != nullptr) return;
+	Schedule* next = m_next.exchange(nullptr, std::memory_order_acq_rel);
+	if (next == nullptr) return;
+
+	for (Node* node : next->nodes) node->m_asleep = false;
+	for (size_t i = 0; i < next->freezes.size(); i++) {
+		Freeze& freeze = *next->freezes[i];
+		Vec<Value>& loop = next->loops[i];
+		if (loop.capacity() <= freeze.loop.capacity()) continue;
+		// Within capacity, so no allocation. The old buffer goes with the schedule.
+		loop.assign(freeze.loop.begin(), freeze.loop.end());
+		std::swap(freeze.loop, loop);
+	}
+	m_retired.store(m_schedule, std::memory_order_release);
+	m_schedule = next;
+}
+
+float NodeGraph::sample() {
+	if (!m_realtime) commit();
+	adopt();
+	const Schedule& schedule = *m_schedule;
+
+	// What the feedback sources produced on the previous sample
+	for (const Copy& copy : schedule.delayed) {
+		if (*copy.to != *copy.from) {
+			*copy.to = *copy.from;
+			copy.node->m_asleep = false;
+		}
+	}
+
+	const Copy* copies = schedule.copies.data();
+	for (const Step& step : schedule.steps) {
+		if (step.kernel != nullptr) {
+			step.kernel->run();
 			continue;
 		}
-		i++;
-		//
-
-		Value sample = conn->from->m_lastSample;
-		if (!conn->from->m_solved) {
-			sample = conn->from->sample(this);
-			conn->from->m_solved = true;
-			conn->from->m_lastSample = sample;
+
+		Node* node = step.node;
+		Freeze* freeze = step.freeze;
+		if (freeze != nullptr && freeze->state == Freeze::Playing) {
+			const Value& sample = freeze->loop[freeze->pos];
+			freeze->pos = (freeze->pos + 1) % u32(freeze->loop.size());
+			node->m_lastSample = sample;
+			if (node->m_buffer != nullptr) {
+				node->updateBuffer(sample.value * sample.velocity * float(sample.gate));
+			}
+			continue;
 		}
 
-		// If it's a writer node, solve "to"
-		if ((conn->to->getType() == WriterNode::typeID() || conn->to->getType() == OutNode::typeID()) &&
-			!conn->to->m_solved) {
-			Value tosample = conn->to->sample(this);
-			conn->to->m_solved = true;
-			conn->to->m_lastSample = tosample;
+		for (u32 c = step.first; c < step.first + step.count; c++) {
+			if (*copies[c].to != *copies[c].from) {
+				*copies[c].to = *copies[c].from;
+				node->m_asleep = false;
+			}
+		}
 
-			conn->to->updateBuffer(tosample.value * tosample.velocity * float(tosample.gate));
+		// Nothing changed since it came to rest, its last output still holds
+		if (!node->m_asleep) {
+			Value sample = node->sample(this);
+			node->m_lastSample = sample;
+			if (node->m_buffer != nullptr) {
+				node->updateBuffer(sample.value * sample.velocity * float(sample.gate));
+			}
+			// At rest the output is silence, exactly, so nothing downstream keeps
+			// ringing on a tiny leftover value
+			node->m_asleep = node->settled();
+			if (node->m_asleep) node->m_lastSample.value = 0.0f;
 		}
 
-		conn->from->updateBuffer(sample.value * sample.velocity * float(sample.gate));
+		if (freeze != nullptr) capture(*freeze, node->m_lastSample);
+	}
 
-		conn->to->in(conn->toSlot).data = sample;
+	if (tick()) {
+		for (auto&& freeze : schedule.freezes) loopStart(*freeze);
 	}
 
-	// Cleanup
-	if (!toRemove.empty()) {
-		std::sort(toRemove.begin(), toRemove.end());
-		std::reverse(toRemove.begin(), toRemove.end());
-		for (u32 idx : toRemove) {
-			m_connections.erase(m_connections.begin() + idx);
-			LogI("Cleaned up invalid connection ", idx);
+	// Edits don't tell the graph, look for them every now and then. The
+	// hashes are taken by commit(), which is asked for fresh ones.
+	if (!schedule.freezes.empty() && ++m_freezeCheck >= TWEN_FREEZE_CHECK_INTERVAL) {
+		m_freezeCheck = 0;
+		for (auto&& freeze : schedule.freezes) {
+			Freeze& f = *freeze;
+			if ((f.state == Freeze::Playing || f.state == Freeze::Failed) && f.current != f.hash) {
+				f.state = Freeze::Waiting;
+				f.attempts = 0;
+				f.loop.clear();
+				m_dirty = true;
+			}
 		}
+		m_rehash = true;
 	}
-	//
 
-	const float step = (1.0f / m_sampleRate) * 4.0f;
+	return schedule.output != nullptr ? schedule.output->m_lastSample.value : 0.0f;
+}
+
+bool NodeGraph::tick() {
+	m_position++;
 
-	m_time += step;
-	if (m_time >= delay()) {
-		m_noteIndex++;
-		m_noteIndex %= (m_bars * 4);
-		m_time = 0.0f;
+	if (m_loopEndFrame > m_loopStartFrame && m_position >= m_loopEndFrame) {
+		seek(m_loopStartFrame);
+		return false;
 	}
 
-	Value smp = m_outputNode != nullptr ? m_outputNode->sample(this) : Value();
-	return smp.value;
+	if (m_position >= m_stepEnd) {
+		m_step++;
+		m_stepStart = m_stepEnd;
+		m_stepEnd = stepFrame(m_step + 1);
+		// Steps shorter than a sample (absurd tempos) are skipped
+		if (m_stepEnd <= m_position) locate(m_position);
+		return index() == 0;
+	}
+	return false;
 }
 
 void NodeGraph::reset() {
-	m_noteIndex = 0;
-	m_time = 0.0f;
+	seek(0);
+}
+
+// "TWST"
+static const u32 StateMagic = 0x54535754;
+static const u32 StateVersion = 2;
+
+void NodeGraph::saveState(StateData& out) const {
+	StateWriter w(out);
+	w << StateMagic << StateVersion;
+	w << m_position << m_globalStorage;
+
+	w << u32(m_nodes.size());
+	for (auto&& node : m_nodes) {
+		const Str type = node->typeName();
+		w << u16(type.size());
+		w.write(type.data(), type.size());
+
+		w << node->m_lastSample << node->m_asleep;
+		for (u32 i = 0; i < node->m_inputCount; i++) {
+			w << node->m_inputs[i].data;
+		}
+
+		// Sized, so a mismatch is caught before anything is restored
+		const size_t sizePos = out.size();
+		w << u32(0);
+		node->saveState(w);
+		const u32 size = u32(out.size() - sizePos - sizeof(u32));
+		std::memcpy(out.data() + sizePos, &size, sizeof(u32));
+	}
+}
+
+bool NodeGraph::restoreState(const StateData& state) {
+	StateReader r(state);
+	u32 magic, version, count;
+	u64 position;
+	r >> magic >> version >> position;
+	if (magic != StateMagic || version != StateVersion) {
+		LogE("Not a graph state.");
+		return false;
+	}
+
+	// Check everything first
+	Arr<Value, TWEN_GLOBAL_STORAGE_SIZE> storage;
+	r >> storage >> count;
+	if (count != m_nodes.size()) {
+		LogE("The state has ", count, " nodes, the graph ", m_nodes.size(), ".");
+		return false;
+	}
+
+	// Where each node's part starts, after its type
+	Vec<size_t> starts;
+	for (auto&& node : m_nodes) {
+		u16 len;
+		r >> len;
+		Str type(len, ' ');
+		r.read(&type[0], len);
+		if (type != node->typeName()) {
+			LogE("State for a ", type, " given to a ", node->typeName(), ".");
+			return false;
+		}
+
+		starts.push_back(r.position());
+		Value skip;
+		bool asleep;
+		r >> skip >> asleep;
+		for (u32 i = 0; i < node->m_inputCount; i++) r >> skip;
+
+		u32 size;
+		r >> size;
+		r.skip(size);
+	}
+	if (!r.ok() || !r.atEnd()) {
+		LogE("Truncated graph state.");
+		return false;
+	}
+
+	locate(position);
+	m_globalStorage = storage;
+
+	for (u32 n = 0; n < m_nodes.size(); n++) {
+		Node* node = m_nodes[n].get();
+		StateReader nr(state.data() + starts[n], state.size() - starts[n]);
+		nr >> node->m_lastSample >> node->m_asleep;
+		for (u32 i = 0; i < node->m_inputCount; i++) {
+			nr >> node->m_inputs[i].data;
+		}
+
+		u32 size;
+		nr >> size;
+		StateReader blob(state.data() + starts[n] + nr.position(), size);
+		node->restoreState(blob);
+		if (!blob.atEnd()) {
+			LogE(node->name(), " didn't read back its whole state.");
+		}
+	}
+
+	// Recorded loops don't line up with the restored position anymore
+	for (auto&& freeze : m_schedule->freezes) {
+		if (freeze->state == Freeze::Failed) continue;
+		if (freeze->state == Freeze::Playing) m_dirty = true;
+		freeze->state = Freeze::Waiting;
+		freeze->loop.clear();
+	}
+	return true;
+}
+
+u64 NodeGraph::loopFrames() const {
+	return frameAt(double(m_bars));
+}
+
+void NodeGraph::freeze(Node* node, bool frozen) {
+	// The schedule being played keeps its own reference, the next one drops it
+	auto pos = std::find_if(m_freezes.begin(), m_freezes.end(), [&](const std::shared_ptr<Freeze>& f) { return f->node == node; });
+	if (frozen && pos == m_freezes.end()) {
+		std::shared_ptr<Freeze> freeze = std::make_shared<Freeze>();
+		freeze->node = node;
+		m_freezes.push_back(std::move(freeze));
+	} else if (!frozen && pos != m_freezes.end()) {
+		m_freezes.erase(pos);
+	}
+	m_dirty = true;
+}
+
+bool NodeGraph::frozen(Node* node) const {
+	return findFreeze(node) != nullptr;
+}
+
+bool NodeGraph::replaying(Node* node) const {
+	Freeze* freeze = findFreeze(node);
+	return freeze != nullptr && freeze->state == Freeze::Playing;
+}
+
+Vec<Node*> NodeGraph::freezesFedBy(Node* node) const {
+	// From the connections, the subgraphs may not be compiled yet
+	Vec<Node*> ret;
+	for (auto&& freeze : m_freezes) {
+		if (freeze->node == node) continue;
+
+		UMap<Node*, bool> seen;
+		Vec<Node*> stack{ freeze->node };
+		seen[freeze->node] = true;
+		while (!stack.empty()) {
+			Node* n = stack.back();
+			stack.pop_back();
+			if (n == node) {
+				ret.push_back(freeze->node);
+				break;
+			}
+			for (auto&& conn : m_connections) {
+				if (conn->to == n && !seen[conn->from]) {
+					seen[conn->from] = true;
+					stack.push_back(conn->from);
+				}
+			}
+		}
+	}
+	return ret;
+}
+
+NodeGraph::Freeze* NodeGraph::findFreeze(Node* node) const {
+	for (auto&& freeze : m_freezes) {
+		if (freeze->node == node) return freeze.get();
+	}
+	return nullptr;
+}
+
+size_t NodeGraph::hashOf(const Freeze& freeze) {
+	JSON json;
+	json["bpm"] = m_bpm;
+	json["bars"] = m_bars;
+	json["sampleRate"] = m_sampleRate;
+	for (const TempoChange& t : m_tempo) json["tempo"].push_back({ t.bar, t.bpm });
+	json["loop"] = { m_loopFrom, m_loopTo };
+
+	UMap<Node*, u32> ids;
+	JSON nodes = JSON::array();
+	for (Node* node : freeze.nodes) {
+		JSON jnode; node->save(jnode);
+		ids[node] = u32(nodes.size());
+		nodes.push_back(jnode);
+	}
+	json["nodes"] = nodes;
+
+	JSON connections = JSON::array();
+	for (auto&& conn : m_connections) {
+		auto to = ids.find(conn->to);
+		if (to == ids.end()) continue;
+		connections.push_back({ ids[conn->from], to->second, conn->toSlot, conn->feedback });
+	}
+	json["connections"] = connections;
+
+	return std::hash<Str>()(json.dump());
+}
+
+size_t NodeGraph::loopCapacity() const {
+	// Steps start on whole samples, so a pass may be a sample longer than the first
+	return std::min(size_t(loopFrames()) + 1, size_t(m_sampleRate) * TWEN_FREEZE_MAX_SECONDS);
+}
+
+void NodeGraph::capture(Freeze& freeze, const Value& value) {
+	switch (freeze.state) {
+		case Freeze::Recording: {
+			if (freeze.loop.size() >= freeze.loop.capacity()) {
+				if (freeze.loop.size() >= size_t(m_sampleRate) * TWEN_FREEZE_MAX_SECONDS) {
+					LogW("The loop of ", freeze.node->name(), " is too long to freeze.");
+					freeze.state = Freeze::Failed;
+					freeze.hash = freeze.current;
+				} else {
+					// The tempo or length changed, commit() grows the buffer
+					freeze.state = Freeze::Waiting;
+				}
+				freeze.loop.clear();
+				return;
+			}
+			freeze.loop.push_back(value);
+		} break;
+		case Freeze::Verifying: {
+			if (freeze.pos >= freeze.loop.size()) {
+				freeze.matches = false;
+				if (freeze.loop.size() < freeze.loop.capacity()) {
+					freeze.loop.push_back(value);
+				} else {
+					freeze.overflow = true;
+				}
+			} else {
+				const Value& prev = freeze.loop[freeze.pos];
+				if (std::abs(prev.value - value.value) > TWEN_SILENCE ||
+					std::abs(prev.velocity - value.velocity) > TWEN_SILENCE ||
+					prev.gate != value.gate)
+				{
+					freeze.matches = false;
+				}
+				// Recorded again, in case this loop doesn't match either
+				freeze.loop[freeze.pos] = value;
+			}
+			freeze.pos++;
+		} break;
+		default: break;
+	}
+}
+
+void NodeGraph::loopStart(Freeze& freeze) {
+	switch (freeze.state) {
+		case Freeze::Waiting: {
+			freeze.loop.clear();
+			freeze.attempts = 0;
+			freeze.hash = freeze.current;
+			// Tried again when the subgraph changes
+			freeze.state = freeze.eligible ? Freeze::Recording : Freeze::Failed;
+		} break;
+		case Freeze::Recording: {
+			freeze.state = Freeze::Verifying;
+			freeze.pos = 0;
+			freeze.matches = true;
+			freeze.overflow = false;
+		} break;
+		case Freeze::Verifying: {
+			const size_t hash = freeze.current;
+			if (freeze.overflow) {
+				// Longer than the buffer, record again once commit() grew it
+				freeze.state = Freeze::Waiting;
+				freeze.loop.clear();
+			} else if (freeze.matches && freeze.pos == freeze.loop.size() && hash == freeze.hash && !freeze.loop.empty()) {
+				freeze.state = Freeze::Playing;
+				freeze.pos = 0;
+				m_dirty = true;
+				LogI("Froze ", freeze.node->name(), ", ", freeze.loop.size(), " samples per loop.");
+			} else if (++freeze.attempts >= TWEN_FREEZE_ATTEMPTS) {
+				LogW(freeze.node->name(), " doesn't repeat every loop, left unfrozen.");
+				freeze.state = Freeze::Failed;
+				freeze.loop.clear();
+				freeze.hash = hash;
+			} else {
+				// The loop just played is the new recording
+				freeze.loop.resize(freeze.pos);
+				freeze.pos = 0;
+				freeze.matches = true;
+				freeze.overflow = false;
+				freeze.hash = hash;
+			}
+		} break;
+		case Freeze::Playing: freeze.pos = 0; break;
+		default: break;
+	}
 }
 
 void NodeGraph::addSample(const Str& fname, const Vec<float>& data, float sr) {
+	addSample(fname, std::make_shared<const Vec<float>>(data), sr);
+}
+
+void NodeGraph::addSample(const Str& fname, Vec<float>&& data, float sr) {
+	addSample(fname, std::make_shared<const Vec<float>>(std::move(data)), sr);
+}
+
+void NodeGraph::addSample(const Str& fname, SampleBuffer data, float sr, const Str& path, u64 frames) {
 	Ptr<RawSample> entry = Ptr<RawSample>(new RawSample());
-	entry->data = data;
+	entry->data = data ? data : std::make_shared<const Vec<float>>();
 	entry->sampleRate = sr;
 	entry->name = fname;
+	entry->path = path;
+	entry->frames = frames;
+	prepareSample(entry.get());
 	m_sampleLibrary[fname] = std::move(entry);
 }
 
-bool NodeGraph::addSample(const Str& fileName) {
+void NodeGraph::addSample(const RawSample& shared) {
+	Ptr<RawSample> entry = Ptr<RawSample>(new RawSample());
+	entry->data = shared.data;
+	entry->sampleRate = shared.sampleRate;
+	entry->name = shared.name;
+	entry->path = shared.path;
+	entry->frames = shared.frames;
+	entry->ready = shared.ready.load();
+	entry->peaks = shared.peaks;
+	if (shared.playbackRate == m_sampleRate || shared.streamed()) {
+		entry->playback = shared.playback;
+		entry->playbackRate = shared.playbackRate;
+	} else {
+		prepareSample(entry.get());
+	}
+	m_sampleLibrary[shared.name] = std::move(entry);
+}
+
+void NodeGraph::prepareSample(RawSample* sample) {
+	if (!sample->peaks && !sample->streamed() && !sample->data->empty()) {
+		sample->peaks = buildPeaks(*sample);
+	}
+
+	if (sample->streamed() || sample->sampleRate == m_sampleRate || sample->data->empty()) {
+		// Streamed samples are interpolated on the fly, the rest of the file is at its own rate
+		sample->playback = sample->data;
+		sample->playbackRate = sample->sampleRate;
+		return;
+	}
+	sample->playback = std::make_shared<const Vec<float>>(
+		Resampler::convert(*sample->data, sample->sampleRate, m_sampleRate)
+	);
+	sample->playbackRate = m_sampleRate;
+}
+
+std::shared_ptr<const PeakPyramid> NodeGraph::buildPeaks(const RawSample& sample) {
+	if (!sample.streamed()) {
+		return PeakPyramid::build(sample.data->data(), sample.data->size());
+	}
+
+	// Only the head is in memory, scan the file
+	Ptr<PeakPyramid> peaks = Ptr<PeakPyramid>(new PeakPyramid());
+	TAudioFile snd(sample.path);
+	Vec<float> chunk(TWEN_STREAM_CHUNK_SIZE);
+	u64 n;
+	while ((n = Sample::readMono(snd, chunk.data(), chunk.size())) > 0) {
+		peaks->add(chunk.data(), n);
+	}
+	return peaks;
+}
+
+void NodeGraph::sampleRate(float sr) {
+	if (sr == m_sampleRate) return;
+	const double at = bar();
+	m_sampleRate = sr;
+	retime();
+	locate(frameAt(at));
+	for (auto&& [name, sample] : m_sampleLibrary) {
+		prepareSample(sample.get());
+	}
+}
+
+RawSample* NodeGraph::addSample(const Str& fileName) {
 	auto pos = fileName.find_last_of('/');
 	if (pos == std::string::npos) {
 		pos = fileName.find_last_of('\\');
 	}
 
-	float sr = 1;
-	std::vector<float> sampleData;
-
 	TAudioFile snd(fileName);
-	int maxSecs = 15;
-	if (snd.sampleRate() > 44100) {
-		maxSecs = 10;
+	if (snd.channels() == 0 || snd.frames() == 0) {
+		return nullptr;
 	}
-	if (snd.frames() < snd.sampleRate() * maxSecs) {
-		sr = snd.sampleRate();
 
-		std::vector<float> samplesRaw;
-		samplesRaw.resize(snd.frames() * snd.channels());
+	const bool stream = Sample::shouldStream(snd.frames(), snd.sampleRate());
 
-		u32 interleavedFrames = snd.readf(&samplesRaw[0], samplesRaw.size());
-
-		sampleData.resize(interleavedFrames);
-		std::fill(sampleData.begin(), sampleData.end(), 0.0f);
-
-		u32 s = 0;
-		for (int i = 0; i < interleavedFrames; i++) {
-			sampleData[i] = samplesRaw[i * snd.channels()];
-		}
+	Vec<float> sampleData;
+	if (stream) {
+		sampleData.resize(std::min(snd.frames(), u64(snd.sampleRate()) * TWEN_SAMPLE_STREAM_HEAD_SECONDS));
+	} else {
+		sampleData.resize(snd.frames());
 	}
+	sampleData.resize(Sample::readMono(snd, sampleData.data(), sampleData.size()));
 
 	if (sampleData.empty()) {
-		return false;
+		return nullptr;
 	}
 
-	addSample(fileName.substr(pos+1), sampleData, sr);
+	const Str name = fileName.substr(pos+1);
+	addSample(
+		name,
+		std::make_shared<const Vec<float>>(std::move(sampleData)),
+		snd.sampleRate(),
+		stream ? fileName : "",
+		stream ? snd.frames() : 0
+	);
 
-	return true;
+	return getSample(name);
 }
 
 void NodeGraph::removeSample(const Str& name) {
@@ -2,22 +2,60 @@
 #define TWEN_NODE_GRAPH_H
 
 #include "intern/Utils.h"
+#include "intern/Sample.h"
+#include "intern/PeakPyramid.h"
 #include "NodeRegistry.h"
+#include "FusedKernel.h"
 
+#include <atomic>
 #include <mutex>
 
 #define TWEN_GLOBAL_STORAGE_SIZE 128
 
+// Loop freezing: how often a replayed subgraph is checked for edits, how
+// many loops it gets to settle into repeating itself, and the longest loop kept
+#define TWEN_FREEZE_CHECK_INTERVAL 4096
+#define TWEN_FREEZE_ATTEMPTS 4
+#define TWEN_FREEZE_MAX_SECONDS 60
+
 struct RawSample {
-	Vec<float> data;
+	SampleBuffer data;
 	float sampleRate;
 	Str name;
+
+	/// Source file and total length of samples streamed from disk. For those,
+	/// data only holds the first few seconds.
+	Str path;
+	u64 frames{ 0 };
+
+	bool streamed() const { return !path.empty(); }
+
+	/// data converted to the engine rate, so unpitched playback needs no
+	/// interpolation. Shares data when the rates match or the sample is streamed.
+	SampleBuffer playback;
+	float playbackRate{ 0.0f };
+
+	/// Waveform overview of the whole sample (the whole file when streamed).
+	std::shared_ptr<const PeakPyramid> peaks;
+
+	/// False while the data is still being decoded by a background loader.
+	std::atomic<bool> ready{ true };
+};
+
+/// The tempo from bar on (see NodeGraph::tempoChange).
+struct TempoChange {
+	double bar;
+	float bpm;
+	/// Where the bar falls, in samples. Kept up to date by the graph.
+	double start{ 0.0 };
 };
 
 class Node;
 class NodeGraph {
+	friend class PatchExporter;
 public:
 	NodeGraph();
+	~NodeGraph();
 
 	Node* add(Node *node);
 	void remove(Node *node);
@@ -29,45 +67,260 @@ public:
 	void disconnect(Connection *conn);
 	Vec<Ptr<Connection>>& connections() { return m_connections; }
 
+	/// Freezes the subgraph that ends at node: one loop period of its output is
+	/// recorded, and once the next loop matches it, replayed instead of
+	/// evaluating node and everything that only feeds it. Editing a node or
+	/// connection of the subgraph (or the tempo) throws the loop away and
+	/// records it again. Subgraphs with non deterministic nodes, or that touch
+	/// the global storage, stay live.
+	void freeze(Node* node, bool frozen);
+	bool frozen(Node* node) const;
+	/// True while node's loop is being replayed.
+	bool replaying(Node* node) const;
+	/// Frozen nodes that read from node, directly or not. While they replay,
+	/// node may not run at all.
+	Vec<Node*> freezesFedBy(Node* node) const;
+
+	/// Asks for the schedule to be rebuilt, e.g. after changing
+	/// Connection::feedback. Adding, removing and connecting do it already.
+	void invalidate() { m_dirty = true; }
+
+	/// Rebuilds the schedule if the graph changed and frees the ones sample()
+	/// is done with. Call it from the thread that edits the graph, sample()
+	/// swaps the new schedule in on its next call.
+	void commit();
+
+	/// For graphs played by another thread (the audio callback): sample()
+	/// then leaves compiling to commit(), so it never allocates or frees.
+	/// Otherwise sample() commits by itself.
+	void realtime(bool rt) { m_realtime = rt; }
+
 	Node* outputNode() { return m_outputNode; }
 
 	void store(u32 loc, Value value) { m_globalStorage[loc] = value; }
 	Value load(u32 loc) const { return m_globalStorage[loc]; }
 
-	bool addSample(const Str& fileName);
+	/// Reads a sound file into the library, nullptr if it couldn't be read.
+	RawSample* addSample(const Str& fileName);
 	void removeSample(const Str& name);
 	RawSample* getSample(const Str& name);
 	Map<Str, Ptr<RawSample>>& sampleLibrary() { return m_sampleLibrary; }
+	const Map<Str, Ptr<RawSample>>& sampleLibrary() const { return m_sampleLibrary; }
 	Vec<Str> getSampleNames();
 
+	// The transport counts samples from bar 0. A bar is the bars() unit:
+	// one beat of the tempo, split into four sequencer steps. Every step
+	// starts on the first sample at or after its exact position, so nothing
+	// drifts however long the song.
+
+	/// Tempo at bar 0. Changing it keeps the transport on the same bar.
 	float bpm() const { return m_bpm; }
-	void bpm(float bpm) { m_bpm = bpm; }
+	void bpm(float bpm);
+
+	/// Tempo from bar on, until the next change.
+	void tempoChange(double bar, float bpm);
+	void clearTempoChanges();
+	/// Sorted by bar, the first one is bpm() at bar 0.
+	const Vec<TempoChange>& tempoChanges() const { return m_tempo; }
+
+	/// Plays bars [start, end) over and over. end <= start turns it off.
+	void loop(double start, double end);
+	double loopBegin() const { return m_loopFrom; }
+	double loopEnd() const { return m_loopTo; }
 
-	u32 index() const { return m_noteIndex; }
+	/// Sequencer step within the pattern, [0, bars() * 4).
+	u32 index() const { return u32(m_step % (u64(m_bars) * 4)); }
 
 	u32 bars() const { return m_bars; }
 	void bars(u32 b) { m_bars = b; }
 
 	float sampleRate() const { return m_sampleRate; }
+	/// Changes the engine rate and converts the sample library to it.
+	void sampleRate(float sr);
 
+	/// How far into the current step, [0, 1).
 	float time();
+	/// Length of a bar at bpm(), in seconds.
 	float delay() const { return (60000.0f / m_bpm) / 1000.0f; }
 
+	/// Song position, in samples.
+	u64 position() const { return m_position; }
+	/// Song position in bars, fractional.
+	double bar() const { return barAt(double(m_position)); }
+
+	/// Exact conversions between bars and samples, through the tempo changes.
+	double sampleAt(double bar) const;
+	double barAt(double sample) const;
+	/// The sample bar starts on.
+	u64 frameAt(double bar) const;
+
+	/// Moves the transport straight to a position, without rendering. The
+	/// nodes keep their state (see saveState for that).
+	void seek(u64 sample);
+	void seekBar(double bar) { seek(frameAt(bar)); }
+
+	/// Tempo, bars, tempo changes and loop of a project document
+	/// ("bpm", "bars", "tempo": [[bar, bpm], ...], "loop": [start, end]).
+	void loadTransport(const JSON& project);
+	void saveTransport(JSON& project) const;
+
 	float sample();
 
+	/// Advances the transport by one sample, sample() does it after the nodes.
+	/// True when the pattern wrapped around to its first step.
+	bool tick();
+
+	/// Back to bar 0.
 	void reset();
 
+	/// Everything needed to continue rendering from this point: the transport,
+	/// the global storage, and each node's inputs, output and saveState().
+	/// Only valid for a graph with the same nodes, in the same order (e.g.
+	/// built from the same project).
+	void saveState(StateData& out) const;
+	/// False, leaving the graph untouched, if state doesn't fit this graph.
+	bool restoreState(const StateData& state);
+
+	/// Frames in the first pass through the pattern, from bar 0.
+	u64 loopFrames() const;
+
 	void addSample(const Str& fname, const Vec<float>& data, float sr);
+	void addSample(const Str& fname, Vec<float>&& data, float sr);
+	void addSample(const Str& fname, SampleBuffer data, float sr, const Str& path = "", u64 frames = 0);
+
+	/// Adds a sample that shares its data (and engine-rate copy) with another library.
+	void addSample(const RawSample& shared);
+
+	/// Builds the engine-rate copy of a sample's data (see RawSample::playback)
+	/// and, for samples in memory, its waveform overview.
+	void prepareSample(RawSample* sample);
+
+	/// The waveform overview. Streamed samples are scanned from disk, which
+	/// takes a while, so that is left to the caller.
+	static std::shared_ptr<const PeakPyramid> buildPeaks(const RawSample& sample);
 private:
 	Node *m_outputNode;
 
 	Vec<Ptr<Node>> m_nodes;
 	Vec<Ptr<Connection>> m_connections;
 
+	/// An input read: *to = *from, straight between the nodes. A change
+	/// wakes node up (see Node::settled).
+	struct Copy {
+		Value* to;
+		const Value* from;
+		Node* node;
+	};
+
+	struct Freeze;
+
+	// Evaluation order built by compile(): every node comes after the nodes it
+	// reads from, except through delayed connections.
+	struct Step {
+		Node* node{ nullptr };
+		/// Runs of Stateless nodes become one step (node is null then).
+		FusedKernel* kernel{ nullptr };
+		/// Set on frozen nodes, which replay the loop while it's Playing.
+		Freeze* freeze{ nullptr };
+		/// The node's inputs, Schedule::copies[first, first + count).
+		u32 first{ 0 }, count{ 0 };
+	};
+
+	struct Schedule {
+		Vec<Step> steps;
+		// Every input read of a sample, contiguous and in execution order
+		Vec<Copy> copies;
+		Vec<Copy> delayed;
+		Vec<Ptr<FusedKernel>> kernels;
+		/// Woken up when the schedule is swapped in.
+		Vec<Node*> nodes;
+		Node* output{ nullptr };
+		/// Removed from the graph while an older schedule could still run them.
+		Vec<Ptr<Node>> removed;
+		/// The frozen subgraphs played, kept alive while the schedule is.
+		Vec<std::shared_ptr<Freeze>> freezes;
+		/// Bigger recording buffers for freezes[i] (empty if it has one big
+		/// enough), swapped in with the schedule.
+		Vec<Vec<Value>> loops;
+	};
+	/// Played by sample(). commit() publishes the next one, sample() swaps it
+	/// in and hands the old one back through m_retired, for commit() to free.
+	Schedule* m_schedule;
+	std::atomic<Schedule*> m_next{ nullptr }, m_retired{ nullptr };
+	std::atomic<bool> m_dirty{ true };
+	bool m_realtime{ false };
+	/// Removed since the last compile().
+	Vec<Ptr<Node>> m_removed;
+
+	struct Freeze {
+		enum State {
+			Waiting = 0, ///< For the loop to start
+			Recording,
+			Verifying, ///< Comparing the loop with the recording, and recording again
+			Playing,
+			Failed ///< Doesn't repeat, stays live until something changes
+		};
+
+		Node* node;
+
+		// Kept by the editing thread (see commit)
+		/// node and everything it reads from, directly or not.
+		Vec<Node*> nodes;
+		/// Frames the recording buffer was last grown to.
+		size_t capacity{ 0 };
+		std::atomic<bool> eligible{ false };
+		/// hashOf() the subgraph as it is now.
+		std::atomic<size_t> current{ 0 };
+
+		// Played by sample()
+		std::atomic<State> state{ Waiting };
+		/// Never grows while playing, a longer loop fails instead.
+		Vec<Value> loop;
+		u32 pos{ 0 }, attempts{ 0 };
+		bool matches{ true }, overflow{ false };
+		/// current when the recording started.
+		size_t hash{ 0 };
+	};
+	Vec<std::shared_ptr<Freeze>> m_freezes;
+	u32 m_freezeCheck{ 0 };
+	/// Set by sample() every TWEN_FREEZE_CHECK_INTERVAL, for commit() to hash the freezes again.
+	std::atomic<bool> m_rehash{ false };
+
+	Freeze* findFreeze(Node* node) const;
+	/// Of the subgraph's parameters and connections, and the transport.
+	/// Reads the editing thread's state, commit() calls it.
+	size_t hashOf(const Freeze& freeze);
+	/// Frames a recording buffer needs, the longest loop that can be frozen.
+	size_t loopCapacity() const;
+	/// Called every sample with node's output, and when the loop wraps.
+	void capture(Freeze& freeze, const Value& value);
+	void loopStart(Freeze& freeze);
+
+	/// A schedule for the graph as it is now.
+	Schedule* compile();
+	/// Builds the steps from the evaluation order, fusing runs of Stateless
+	/// nodes into FusedKernel steps.
+	void schedule(Schedule& out, const Vec<Node*>& order, UMap<Node*, Vec<Connection*>>& inputs);
+	/// Swaps in the schedule commit() published, once the last retired one is freed.
+	void adopt();
+
 	std::mutex m_lock;
 
-	float m_gain, m_time, m_sampleRate, m_bpm;
-	u32 m_noteIndex, m_bars;
+	float m_gain, m_sampleRate, m_bpm;
+	u32 m_bars;
+
+	Vec<TempoChange> m_tempo;
+	double m_loopFrom{ 0.0 }, m_loopTo{ 0.0 };
+
+	// Transport, in samples. The current step is [m_stepStart, m_stepEnd)
+	u64 m_position{ 0 }, m_step{ 0 }, m_stepStart{ 0 }, m_stepEnd{ 0 };
+	u64 m_loopStartFrame{ 0 }, m_loopEndFrame{ 0 };
+
+	/// Recomputes where the tempo changes and the loop fall, in samples.
+	void retime();
+	/// Moves the transport only (seek also restarts the frozen loops).
+	void locate(u64 sample);
+	u64 stepFrame(u64 step) const { return frameAt(double(step) / 4.0); }
 
 	Arr<Value, TWEN_GLOBAL_STORAGE_SIZE> m_globalStorage;
 
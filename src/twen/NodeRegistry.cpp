@@ -1,3 +1,4 @@
 #include "NodeRegistry.h"
 
-Map<Str, NodeFactory> NodeBuilder::factories;
\ No newline at end of file
+Map<Str, NodeFactory> NodeBuilder::factories;
+Vec<u32> NodeBuilder::kindTraits;
\ No newline at end of file
@@ -11,21 +11,24 @@ struct IsNode { static const bool value = false; };
 template <class Nt>
 struct IsNode<Nt, decltype(Nt::typeID())> { static const bool value = true; };
 
-using NodeCtor = Node*(JSON);
-#define TWEN_NODE_FAC [](JSON json) -> Node*
+using NodeCtor = Node*(const JSON&);
+#define TWEN_NODE_FAC [](const JSON& json) -> Node*
 
 struct NodeFactory {
 	NodeCtor* ctor;
 	Str category, title, type;
 	TypeIndex typeID;
+	NodeKind kind;
+	u32 traits;
 
-	NodeFactory() : typeID(Utils::getTypeIndex<Node>()) {}
+	NodeFactory() : typeID(Utils::getTypeIndex<Node>()), kind(0), traits(0) {}
 };
 
 class NodeBuilder {
 public:
+	/// traits is a combination of Node::Trait flags.
 	template <typename Nt>
-	static void registerType(const Str& category, NodeCtor* factory) {
+	static void registerType(const Str& category, NodeCtor* factory, u32 traits = 0) {
 		static_assert(
 			std::is_base_of<Node, Nt>::value,
 			"The node must be derived from 'Node'."
@@ -39,9 +42,19 @@ public:
 		factories[Nt::type()].title = Nt::prettyName();
 		factories[Nt::type()].type = Nt::type();
 		factories[Nt::type()].typeID = Nt::typeID();
+		factories[Nt::type()].kind = Nt::kind();
+		factories[Nt::type()].traits = traits;
+
+		if (Nt::kind() >= kindTraits.size()) kindTraits.resize(Nt::kind() + 1, 0);
+		kindTraits[Nt::kind()] = traits;
+	}
+
+	/// Traits of a registered kind, 0 for unknown kinds.
+	static u32 traitsOf(NodeKind kind) {
+		return kind < kindTraits.size() ? kindTraits[kind] : 0;
 	}
 
-	static Node* createNode(const Str& typeName, JSON params) {
+	static Node* createNode(const Str& typeName, const JSON& params) {
 		if (factories.find(typeName) == factories.end()) {
 			LogE("Invalid node type.");
 			return nullptr;
@@ -50,10 +63,17 @@ public:
 		nd->m_name = factories[typeName].title;
 		nd->m_typeName = factories[typeName].type;
 		nd->m_type = factories[typeName].typeID;
+		nd->m_kind = factories[typeName].kind;
+		nd->m_traits = factories[typeName].traits;
+		if (nd->is(Node::Sink)) {
+			nd->m_buffer = Ptr<Arr<float, TWEN_NODE_BUFFER_SIZE>>(new Arr<float, TWEN_NODE_BUFFER_SIZE>());
+			nd->m_buffer->fill(0.0f);
+		}
 		return nd;
 	}
 
 	static Map<Str, NodeFactory> factories;
+	static Vec<u32> kindTraits;
 };
 
 #endif // TWEN_NODE_REGISTRY_H
@@ -0,0 +1,225 @@
+#include "PatchExporter.h"
+
+#include "Renderer.h"
+#include "intern/Log.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+	/// A float literal that reads back as the same value.
+	Str literal(float value) {
+		if (std::isnan(value)) return "std::numeric_limits<float>::quiet_NaN()";
+		if (std::isinf(value)) return value > 0.0f ? "std::numeric_limits<float>::infinity()" : "-std::numeric_limits<float>::infinity()";
+
+		// The shortest form that reads back exactly
+		char buf[32];
+		for (int digits = 6; digits <= 9; digits++) {
+			std::snprintf(buf, sizeof(buf), "%.*g", digits, value);
+			if (std::strtof(buf, nullptr) == value) break;
+		}
+		Str ret = buf;
+		if (ret.find_first_of(".e") == Str::npos) ret += ".0";
+		return ret + "f";
+	}
+
+	/// Same for doubles (positions in bars).
+	Str literal(double value) {
+		char buf[32];
+		for (int digits = 15; digits <= 17; digits++) {
+			std::snprintf(buf, sizeof(buf), "%.*g", digits, value);
+			if (std::strtod(buf, nullptr) == value) break;
+		}
+		Str ret = buf;
+		if (ret.find_first_of(".e") == Str::npos) ret += ".0";
+		return ret;
+	}
+}
+
+bool PatchExporter::build(const JSON& project, const Str& className) {
+	m_source.clear();
+
+	Renderer renderer;
+	if (!renderer.build(project)) return false;
+
+	NodeGraph& graph = renderer.graph();
+	Ptr<NodeGraph::Schedule> schedule(graph.compile());
+
+	// Variables are named after the node ids of the project file: 0 is the
+	// output, nodes[i] is i + 1
+	UMap<Node*, Str> names;
+	names[graph.outputNode()] = "0";
+	for (u32 i = 0; i < renderer.nodes().size(); i++) {
+		names[renderer.nodes()[i]] = std::to_string(i + 1);
+	}
+
+	Vec<Node*> order;
+	for (auto&& step : schedule->steps) {
+		if (step.kernel != nullptr) {
+			for (Node* node : step.kernel->nodes()) order.push_back(node);
+		} else {
+			order.push_back(step.node);
+		}
+	}
+
+	std::ostringstream constants, setup, samples, members, outputs, asleep, feedback, body;
+	for (Node* node : order) {
+		m_var = "n" + names[node];
+		m_constants.str(""); m_setup.str(""); m_samples.str("");
+		if (!node->exportParams(*this)) {
+			LogE("Cannot export ", node->name(), " nodes.");
+			return false;
+		}
+
+		const Str type = node->typeName();
+		if (!m_constants.str().empty()) {
+			constants << "\n\t// " << names[node] << ": " << node->name() << "\n" << m_constants.str();
+		}
+		setup << m_setup.str();
+		samples << m_samples.str();
+		members << "\t" << type << " " << m_var << ";\n";
+		outputs << (outputs.tellp() == 0 ? "\tValue o" : ", o") << names[node];
+		asleep << (asleep.tellp() == 0 ? "\tbool s" : ", s") << names[node] << "{ false }";
+
+		// Same sleep rule as NodeGraph: skipped while settled and fed the same inputs
+		const Str sleep = "s" + names[node];
+		for (auto&& conn : graph.connections()) {
+			if (conn->to != node) continue;
+			Str copy = "\t\tif (copy(" + m_var + ".in(" + std::to_string(conn->toSlot) + ").data, o" + names[conn->from] + ")) " + sleep + " = false;\n";
+			setup << "\t\t" << m_var << ".in(" << conn->toSlot << ").connected = true;\n";
+			if (conn->delayed) feedback << copy;
+			else body << copy;
+		}
+		body << "\t\tif (!" << sleep << ") {\n";
+		body << "\t\t\to" << names[node] << " = " << m_var << "." << type << "::sample(&m_context);\n";
+		body << "\t\t\tif ((" << sleep << " = " << m_var << "." << type << "::settled())) o" << names[node] << ".value = 0.0f;\n";
+		body << "\t\t}\n";
+	}
+	if (outputs.tellp() != 0) outputs << ";\n";
+	if (asleep.tellp() != 0) asleep << ";\n";
+
+	std::ostringstream src;
+	src << "// Generated by Twist from a patch. Do not edit, export it again instead.\n";
+	src << "// Build it with the twen headers in the include path and link twen.\n\n";
+	src << "#include \"Twen.h\"\n\n";
+	src << "#include <limits>\n\n";
+
+	src << "class " << className << " {\n";
+	src << "public:\n";
+	src << "\tstatic constexpr float SampleRate = " << literal(graph.sampleRate()) << ";\n";
+	src << "\tstatic constexpr float Bpm = " << literal(graph.bpm()) << ";\n";
+	src << "\tstatic constexpr u32 Bars = " << graph.bars() << ";\n";
+	src << constants.str() << "\n";
+
+	src << "\t" << className << "() {\n";
+	src << "\t\tm_context.sampleRate(SampleRate);\n";
+	src << "\t\tm_context.bpm(Bpm);\n";
+	src << "\t\tm_context.bars(Bars);\n";
+	for (const TempoChange& t : graph.tempoChanges()) {
+		if (t.bar <= 0.0) continue;
+		src << "\t\tm_context.tempoChange(" << literal(t.bar) << ", " << literal(t.bpm) << ");\n";
+	}
+	if (graph.loopEnd() > graph.loopBegin()) {
+		src << "\t\tm_context.loop(" << literal(graph.loopBegin()) << ", " << literal(graph.loopEnd()) << ");\n";
+	}
+	src << "\n";
+	src << setup.str();
+	src << "\t}\n\n";
+
+	src << "\t/// Gives the patch the samples it plays. They must be fully in memory,\n";
+	src << "\t/// see Renderer::loadStreamed.\n";
+	src << "\tvoid bindSamples(const NodeGraph& library) {\n";
+	src << "\t\tfor (auto&& [name, sample] : library.sampleLibrary()) {\n";
+	src << "\t\t\tm_context.addSample(*sample);\n";
+	src << "\t\t}\n";
+	src << samples.str();
+	src << "\t}\n\n";
+
+	src << "\t/// Renders frames of mono audio at SampleRate.\n";
+	src << "\tvoid render(float* out, u32 frames) {\n";
+	src << "\t\tfor (u32 i = 0; i < frames; i++) {\n";
+	src << "\t\t\tout[i] = step();\n";
+	src << "\t\t}\n";
+	src << "\t}\n\n";
+
+	src << "private:\n";
+	src << "\t// Transport, storage and samples. The graph itself is never walked.\n";
+	src << "\tNodeGraph m_context;\n\n";
+	src << members.str() << "\n";
+	src << "\t// What each node produced last, and whether it is asleep (see Node::settled)\n";
+	src << outputs.str();
+	src << asleep.str() << "\n";
+
+	src << "\tstatic bool copy(Value& to, const Value& from) {\n";
+	src << "\t\tif (to == from) return false;\n";
+	src << "\t\tto = from;\n";
+	src << "\t\treturn true;\n";
+	src << "\t}\n\n";
+
+	if (samples.tellp() != 0) {
+		src << "\tstatic void bind(SamplerNode& node, NodeGraph& context, const char* name) {\n";
+		src << "\t\tRawSample* sample = context.getSample(name);\n";
+		src << "\t\tif (sample == nullptr) return;\n";
+		src << "\t\tnode.sampleData = Sample(sample->playback, sample->playbackRate);\n";
+		src << "\t}\n\n";
+	}
+
+	src << "\tfloat step() {\n";
+	if (feedback.tellp() != 0) {
+		src << "\t\t// Feedback, from the previous sample\n";
+		src << feedback.str() << "\n";
+	}
+	src << body.str();
+	src << "\n\t\tm_context.tick();\n";
+	src << "\t\treturn o0.value;\n";
+	src << "\t}\n";
+	src << "};\n";
+
+	m_source = src.str();
+	return true;
+}
+
+bool PatchExporter::write(const Str& fileName) const {
+	std::ofstream fp(fs::u8path(fileName));
+	if (!fp.good()) {
+		LogE("Could not write ", fileName);
+		return false;
+	}
+	fp << m_source;
+	return fp.good();
+}
+
+Str PatchExporter::classNameOf(const Str& fileName) {
+	Str name = fs::u8path(fileName).stem().u8string();
+	for (char& c : name) {
+		if (!std::isalnum(u8(c))) c = '_';
+	}
+	if (name.empty() || std::isdigit(u8(name[0]))) name = "Patch_" + name;
+	return name;
+}
+
+void PatchExporter::param(const char* field, float value) {
+	m_constants << "\tstatic constexpr float " << m_var << "_" << field << " = " << literal(value) << ";\n";
+	m_setup << "\t\t" << m_var << "." << field << " = " << m_var << "_" << field << ";\n";
+}
+
+void PatchExporter::param(const char* field, u32 value) {
+	m_constants << "\tstatic constexpr u32 " << m_var << "_" << field << " = " << value << ";\n";
+	m_setup << "\t\t" << m_var << "." << field << " = " << m_var << "_" << field << ";\n";
+}
+
+void PatchExporter::param(const char* field, int value, const char* type) {
+	m_constants << "\tstatic constexpr int " << m_var << "_" << field << " = " << value << ";\n";
+	m_setup << "\t\t" << m_var << "." << field << " = " << type << "(" << m_var << "_" << field << ");\n";
+}
+
+void PatchExporter::sample(const Str& name) {
+	if (name.empty()) return;
+	m_samples << "\t\tbind(" << m_var << ", m_context, " << JSON(name).dump() << ");\n";
+}
@@ -0,0 +1,43 @@
+#ifndef TWEN_PATCH_EXPORTER_H
+#define TWEN_PATCH_EXPORTER_H
+
+#include "intern/Utils.h"
+
+#include <sstream>
+
+class Node;
+
+/// Turns a fixed project into a C++ class that plays it without the
+/// interpreter: parameters become constexpr, the nodes are plain members
+/// called through their concrete type in the order the graph compiler picked,
+/// and connections are straight assignments. The generated source only needs
+/// the twen headers and library, and renders the same samples as Renderer.
+class PatchExporter {
+public:
+	/// Generates the source of a project document (see TNodeGraph::toJSON),
+	/// as class className. False if some node type cannot be exported.
+	bool build(const JSON& project, const Str& className = "Patch");
+
+	const Str& source() const { return m_source; }
+	bool write(const Str& fileName) const;
+
+	/// Class name from a file name, e.g. "my song.cpp" -> "my_song".
+	static Str classNameOf(const Str& fileName);
+
+	/// For Node::exportParams: a parameter the generated code assigns once.
+	void param(const char* field, float value);
+	void param(const char* field, u32 value);
+	/// An enum member, type is its C++ type.
+	void param(const char* field, int value, const char* type);
+	/// SamplerNode: the sample to play, bound by the generated bindSamples().
+	void sample(const Str& name);
+
+private:
+	Str m_source;
+
+	// Per node, while exporting it
+	Str m_var;
+	std::ostringstream m_constants, m_setup, m_samples;
+};
+
+#endif // TWEN_PATCH_EXPORTER_H
@@ -0,0 +1,316 @@
+#include "ProjectReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "NodeGraph.h"
+#include "intern/Log.h"
+
+#define PROJECT_READER_RESERVE (1 << 16)
+
+using JSONSax = nlohmann::json_sax<JSON>;
+
+// Builds the document from the events, except for the root "samples" array,
+// which is collected here and added to the document as an empty array.
+class ProjectSax : public JSONSax {
+public:
+	ProjectSax(JSON& doc, Vec<Ptr<RawSample>>& samples, Vec<u64>& sizes)
+		: m_root(doc), m_samples(samples), m_sizes(sizes)
+	{}
+
+	bool null() override {
+		if (!m_capturing) add(JSON());
+		return true;
+	}
+
+	bool boolean(bool val) override {
+		if (!m_capturing) add(JSON(val));
+		return true;
+	}
+
+	bool number_integer(number_integer_t val) override {
+		if (m_capturing) return number(float(val));
+		add(JSON(val));
+		return true;
+	}
+
+	bool number_unsigned(number_unsigned_t val) override {
+		if (m_capturing && m_current && m_depth == m_captureDepth + 1 && m_sampleKey == "frames") {
+			m_current->frames = val;
+			return true;
+		}
+		if (m_capturing) return number(float(val));
+		add(JSON(val));
+		return true;
+	}
+
+	bool number_float(number_float_t val, const string_t& s) override {
+		if (m_capturing) return number(float(val));
+		add(JSON(val));
+		return true;
+	}
+
+	bool string(string_t& val) override {
+		if (!m_capturing) {
+			add(JSON(std::move(val)));
+			return true;
+		}
+		if (m_depth == m_captureDepth + 1 && m_sampleKey == "sampleName") {
+			m_current->name = val;
+		} else if (m_depth == m_captureDepth + 1 && m_sampleKey == "path") {
+			m_current->path = val;
+		}
+		return true;
+	}
+
+	bool start_object(std::size_t elements) override {
+		m_depth++;
+		if (!m_capturing) {
+			m_stack.push_back(add(JSON::object()));
+			return true;
+		}
+		if (m_depth == m_captureDepth + 1) {
+			m_current = Ptr<RawSample>(new RawSample());
+			m_current->sampleRate = 44100.0f;
+			m_sizes.push_back(0);
+		}
+		return true;
+	}
+
+	bool key(string_t& val) override {
+		if (!m_capturing) {
+			if (m_depth == 1) m_rootKey = val;
+			m_member = &(*m_stack.back())[val];
+			return true;
+		}
+		if (m_depth == m_captureDepth + 1) {
+			m_sampleKey = val;
+		}
+		return true;
+	}
+
+	bool end_object() override {
+		m_depth--;
+		if (!m_capturing) {
+			m_stack.pop_back();
+			return true;
+		}
+		if (m_depth == m_captureDepth && m_current) {
+			m_current->data = std::make_shared<const Vec<float>>(std::move(m_data));
+			m_data = Vec<float>();
+			m_samples.push_back(std::move(m_current));
+		}
+		return true;
+	}
+
+	bool start_array(std::size_t elements) override {
+		if (!m_capturing && m_depth == 1 && m_rootKey == "samples") {
+			m_capturing = true;
+			m_captureDepth = ++m_depth;
+			return true;
+		}
+		m_depth++;
+		if (!m_capturing) {
+			m_stack.push_back(add(JSON::array()));
+			return true;
+		}
+		if (m_depth == m_captureDepth + 2 && m_sampleKey == "data" && m_current) {
+			m_data.reserve(PROJECT_READER_RESERVE);
+		}
+		return true;
+	}
+
+	bool end_array() override {
+		if (m_capturing && m_depth == m_captureDepth) {
+			m_capturing = false;
+			m_depth--;
+			add(JSON::array());
+			return true;
+		}
+		m_depth--;
+		if (!m_capturing) m_stack.pop_back();
+		return true;
+	}
+
+	bool parse_error(
+		std::size_t position,
+		const std::string& lastToken,
+		const nlohmann::detail::exception& ex
+	) override {
+		LogE("Parse error at ", position, ": ", ex.what());
+		return false;
+	}
+
+private:
+	JSON& m_root;
+	// Objects and arrays being filled, and the member the last key named
+	Vec<JSON*> m_stack;
+	JSON* m_member{ nullptr };
+	Vec<Ptr<RawSample>>& m_samples;
+	Vec<u64>& m_sizes;
+	Ptr<RawSample> m_current;
+	Vec<float> m_data;
+
+	Str m_rootKey, m_sampleKey;
+	u32 m_depth{ 0 }, m_captureDepth{ 0 };
+	bool m_capturing{ false };
+
+	/// Puts a value where the parser is: the root, the end of an array or the member of the last key.
+	JSON* add(JSON&& value) {
+		if (m_stack.empty()) {
+			m_root = std::move(value);
+			return &m_root;
+		}
+		JSON& parent = *m_stack.back();
+		if (parent.is_array()) {
+			parent.push_back(std::move(value));
+			return &parent.back();
+		}
+		*m_member = std::move(value);
+		return m_member;
+	}
+
+	bool number(float val) {
+		if (!m_current) return true;
+		if (m_depth == m_captureDepth + 2 && m_sampleKey == "data") {
+			m_data.push_back(val);
+		} else if (m_depth == m_captureDepth + 1 && m_sampleKey == "sampleRate") {
+			m_current->sampleRate = val;
+		} else if (m_depth == m_captureDepth + 1 && m_sampleKey == "sampleSize") {
+			m_sizes.back() = u64(val);
+		}
+		return true;
+	}
+};
+
+bool ProjectReader::open(const Str& fileName) {
+	m_document = JSON();
+	m_samples.clear();
+	m_sampleSizes.clear();
+	m_spans.clear();
+	m_text.clear();
+
+	std::ifstream fp(fileName, std::ios::binary | std::ios::ate);
+	if (!fp.good()) {
+		LogE("Could not open project: ", fileName);
+		return false;
+	}
+
+	m_text.resize(size_t(fp.tellg()));
+	fp.seekg(0);
+	fp.read(&m_text[0], m_text.size());
+	fp.close();
+
+	scan();
+
+	// Everything but the sample payloads
+	Str skeleton;
+	size_t prev = 0;
+	for (auto&& [begin, end] : m_spans) {
+		if (end == 0) continue;
+		skeleton.append(m_text, prev, begin - prev);
+		skeleton.append("[]");
+		prev = end;
+	}
+	skeleton.append(m_text, prev, Str::npos);
+
+	ProjectSax sax(m_document, m_samples, m_sampleSizes);
+	if (!JSON::sax_parse(skeleton, &sax) || !m_document.is_object()) {
+		m_document = JSON();
+		m_samples.clear();
+		m_spans.clear();
+		m_text.clear();
+		return false;
+	}
+	m_spans.resize(m_samples.size(), { 0, 0 });
+	return true;
+}
+
+void ProjectReader::decode(u32 index, Vec<float>& out) const {
+	if (index >= m_spans.size() || m_spans[index].second == 0)
+		return;
+
+	const char* p = m_text.data() + m_spans[index].first + 1;
+	const char* end = m_text.data() + m_spans[index].second - 1;
+
+	u64 size = index < m_sampleSizes.size() ? m_sampleSizes[index] : 0;
+	if (size == 0) size = std::count(p, end, ',') + 1;
+
+	out.clear();
+	out.reserve(size);
+	while (p < end) {
+		char* next = nullptr;
+		float v = std::strtof(p, &next);
+		if (next == p) { p++; continue; }
+		out.push_back(v);
+		p = next;
+	}
+}
+
+bool ProjectReader::read(const Str& fileName) {
+	if (!open(fileName)) return false;
+	for (u32 i = 0; i < m_samples.size(); i++) {
+		Vec<float> data;
+		decode(i, data);
+		m_samples[i]->data = std::make_shared<const Vec<float>>(std::move(data));
+	}
+	return true;
+}
+
+// Finds the [begin, end) range of every samples[i].data array without parsing
+// the numbers, keeping track of strings so brackets inside them are ignored.
+void ProjectReader::scan() {
+	const char* s = m_text.data();
+	const size_t n = m_text.size();
+
+	Str key;
+	int depth = 0;
+	bool inSamples = false;
+
+	size_t i = 0;
+	while (i < n) {
+		const char c = s[i];
+		if (c == '"') {
+			size_t begin = ++i;
+			while (i < n && s[i] != '"') {
+				if (s[i] == '\\') i++;
+				i++;
+			}
+			size_t end = i++;
+
+			size_t j = i;
+			while (j < n && std::isspace(u8(s[j]))) j++;
+			if (j < n && s[j] == ':') key.assign(s + begin, end - begin);
+			continue;
+		}
+
+		switch (c) {
+			case '{': {
+				depth++;
+				if (inSamples && depth == 3) m_spans.push_back({ 0, 0 });
+			} break;
+			case '}': depth--; break;
+			case '[': {
+				if (!inSamples && depth == 1 && key == "samples") {
+					inSamples = true;
+				} else if (inSamples && depth == 3 && key == "data" && !m_spans.empty()) {
+					const char* close = (const char*) std::memchr(s + i, ']', n - i);
+					if (close == nullptr) return;
+					m_spans.back() = { i, size_t(close - s) + 1 };
+					i = size_t(close - s) + 1;
+					continue;
+				}
+				depth++;
+			} break;
+			case ']': {
+				depth--;
+				if (inSamples && depth == 1) inSamples = false;
+			} break;
+			default: break;
+		}
+		i++;
+	}
+}
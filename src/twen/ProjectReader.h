@@ -0,0 +1,36 @@
+#ifndef TWEN_PROJECT_READER_H
+#define TWEN_PROJECT_READER_H
+
+#include "intern/Utils.h"
+
+struct RawSample;
+
+/// Reads project files in two steps.
+/// open() loads the file, locates the sample payloads with a quick structural
+/// scan and streams everything else through a SAX parser, so the graph can be
+/// built right away. Each payload is then decoded with decode(), which can run
+/// on any thread, straight into a float buffer sized from "sampleSize".
+/// The sample library is left empty in document(); see samples().
+class ProjectReader {
+public:
+	bool open(const Str& fileName);
+	void decode(u32 index, Vec<float>& out) const;
+
+	/// open() + decode() of every sample.
+	bool read(const Str& fileName);
+
+	const JSON& document() const { return m_document; }
+	Vec<Ptr<RawSample>>& samples() { return m_samples; }
+
+private:
+	JSON m_document;
+	Vec<Ptr<RawSample>> m_samples;
+	Vec<u64> m_sampleSizes;
+
+	Str m_text;
+	Vec<std::pair<size_t, size_t>> m_spans;
+
+	void scan();
+};
+
+#endif // TWEN_PROJECT_READER_H
@@ -0,0 +1,305 @@
+#include "Renderer.h"
+
+#include "TAudio.h"
+#include "NodeRegistry.h"
+#include "nodes/OutNode.hpp"
+#include "intern/Log.h"
+#include "intern/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+Renderer::Renderer(float sampleRate) {
+	m_graph = Ptr<NodeGraph>(new NodeGraph());
+	m_graph->sampleRate(sampleRate);
+}
+
+void Renderer::shareSamples(const NodeGraph& library) {
+	for (auto&& [name, sample] : library.sampleLibrary()) {
+		m_graph->addSample(*sample);
+	}
+}
+
+bool Renderer::build(const JSON& project) {
+	m_graph->loadTransport(project);
+
+	// Connections refer to the output node as 0 and to nodes[i] as i + 1
+	Vec<Node*> ids;
+	ids.push_back(m_graph->add(NodeBuilder::createNode(OutNode::type(), JSON::object())));
+
+	auto nodes = project.find("nodes");
+	if (nodes != project.end() && nodes->is_array()) {
+		for (const JSON& node : *nodes) {
+			if (node.count("type") == 0) {
+				LogE("Node without a type.");
+				return false;
+			}
+			Node* n = m_graph->add(NodeBuilder::createNode(node.value("type", Str()), node));
+			if (n == nullptr) return false;
+			n->load(node);
+			if (node.value("frozen", false)) m_graph->freeze(n, true);
+			m_nodes.push_back(n);
+			ids.push_back(n);
+		}
+	}
+
+	auto connections = project.find("connections");
+	if (connections != project.end() && connections->is_array()) {
+		for (const JSON& conn : *connections) {
+			// Missing fields read as out of range and fail below
+			u32 from = conn.value("from", u32(-1)), to = conn.value("to", u32(-1)), slot = conn.value("slot", u32(-1));
+			if (from >= ids.size() || to >= ids.size() || slot >= ids[to]->inputCount()) {
+				LogE("Invalid connection: ", from, " -> ", to, ":", slot);
+				return false;
+			}
+			Connection* c = m_graph->connect(ids[from], ids[to], slot);
+			c->feedback = conn.value("feedback", false);
+		}
+	}
+
+	m_receivers.clear();
+	for (Node* node : m_nodes) {
+		if (MidiReceiver* receiver = dynamic_cast<MidiReceiver*>(node)) m_receivers.push_back(receiver);
+	}
+
+	m_graph->reset();
+	m_project = project;
+	m_position = 0;
+	seekMidi();
+	m_start.clear();
+	m_graph->saveState(m_start);
+	return true;
+}
+
+float Renderer::step() {
+	while (m_midiNext < m_midi.size() && m_midi[m_midiNext].frame <= m_position) {
+		const MidiEvent& event = m_midi[m_midiNext++];
+		for (MidiReceiver* receiver : m_receivers) {
+			const int channel = receiver->midiChannel();
+			if (channel == -1 || channel == event.channel()) receiver->midiEvent(event);
+		}
+	}
+
+	m_position++;
+	return m_graph->sample();
+}
+
+void Renderer::midi(Vec<MidiEvent> events) {
+	m_midi = std::move(events);
+	std::stable_sort(m_midi.begin(), m_midi.end(), [](const MidiEvent& a, const MidiEvent& b) { return a.frame < b.frame; });
+	seekMidi();
+	if (!m_midi.empty() && m_receivers.empty()) {
+		LogW("The project has no MIDI nodes to play the events.");
+	}
+}
+
+void Renderer::seekMidi() {
+	auto pos = std::lower_bound(m_midi.begin(), m_midi.end(), m_position, [](const MidiEvent& e, u64 frame) { return e.frame < frame; });
+	m_midiNext = size_t(pos - m_midi.begin());
+}
+
+u64 Renderer::render(TAudioFile& file, u64 frames) {
+	return render(file, frames, {});
+}
+
+u64 Renderer::render(TAudioFile& file, u64 frames, const Vec<Stem>& stems) {
+	float chunk[TWEN_RENDER_CHUNK_SIZE];
+
+	for (const Stem& stem : stems) {
+		for (Node* frozen : m_graph->freezesFedBy(stem.node)) {
+			LogW("Unfroze ", frozen->name(), " to render the stem of ", stem.node->name(), ".");
+			m_graph->freeze(frozen, false);
+		}
+	}
+	Vec<float> stemChunks(stems.size() * TWEN_RENDER_CHUNK_SIZE);
+
+	u64 written = 0;
+	while (written < frames) {
+		u64 n = std::min<u64>(frames - written, TWEN_RENDER_CHUNK_SIZE);
+		for (u64 i = 0; i < n; i++) {
+			float s = step();
+			chunk[i] = s;
+			m_peak = std::max(m_peak, std::abs(s));
+			m_sumSquares += double(s) * double(s);
+
+			for (size_t t = 0; t < stems.size(); t++) {
+				const Value& out = stems[t].node->output();
+				stemChunks[t * TWEN_RENDER_CHUNK_SIZE + i] = out.value * out.velocity * float(out.gate);
+			}
+		}
+		m_rendered += n;
+
+		u64 w = file.writef(chunk, n);
+		for (size_t t = 0; t < stems.size(); t++) {
+			if (stems[t].file->writef(stemChunks.data() + t * TWEN_RENDER_CHUNK_SIZE, n) < n) {
+				LogE("Could not write the stem of ", stems[t].node->name(), ".");
+				w = 0;
+			}
+		}
+		written += w;
+		if (w < n) break;
+	}
+	return written;
+}
+
+Node* Renderer::findNode(const JSON& ref) const {
+	if (ref.is_number_unsigned()) {
+		const u32 index = ref.get<u32>();
+		if (index < m_nodes.size()) return m_nodes[index];
+		LogE("No node ", index, ", the project has ", m_nodes.size(), ".");
+		return nullptr;
+	}
+	if (!ref.is_string()) {
+		LogE("Nodes are referred to by index or by label, not ", ref.dump(), ".");
+		return nullptr;
+	}
+
+	const Str label = ref.get<Str>();
+	Node* ret = nullptr;
+	for (Node* node : m_nodes) {
+		if (node->label() != label) continue;
+		if (ret != nullptr) {
+			LogE("More than one node is labeled ", label, ".");
+			return nullptr;
+		}
+		ret = node;
+	}
+	if (ret == nullptr) LogE("No node is labeled ", label, ".");
+	return ret;
+}
+
+u64 Renderer::loopLength() const {
+	return m_graph->loopFrames();
+}
+
+u64 Renderer::renderParallel(TAudioFile& file, u64 frames, u32 threads) {
+	if (m_position != 0) {
+		if (!m_graph->restoreState(m_start)) return 0;
+		m_position = 0;
+		seekMidi();
+	}
+
+	// Tempo changes, loop regions and MIDI make the song stop repeating every pattern
+	if (m_graph->tempoChanges().size() > 1 || m_graph->loopEnd() > m_graph->loopBegin() || !m_midi.empty()) {
+		return render(file, frames);
+	}
+
+	const u64 loop = loopLength();
+	// Where the transport was at frame 0, the segments continue from there
+	const u64 origin = m_graph->position();
+	const u64 fade = std::min<u64>(TWEN_RENDER_CROSSFADE, loop);
+
+	// The caller renders the first segment, the workers the others. Segments
+	// are whole loops, enough for the first one to cover a warm up
+	ThreadPool pool(threads);
+	u64 segments = pool.size() + 1;
+	const u64 loops = std::max<u64>((frames / loop + segments - 1) / segments, 3);
+	const u64 length = loops * loop;
+	segments = (frames + length - 1) / length;
+	if (segments < 2) return render(file, frames);
+
+	Vec<Vec<float>> out(segments);
+	out[0].reserve(length);
+
+	// Every other segment starts fade frames before a loop boundary, once the
+	// last loop sounded like the one before
+	u64 warm = 2 * loop - fade;
+	while (true) {
+		while (out[0].size() < warm) out[0].push_back(step());
+		if (warm + loop > length) {
+			LogI("The patch doesn't repeat every loop, the segments are crossfaded.");
+			break;
+		}
+		if (warm >= 2 * loop) {
+			const float* o = out[0].data();
+			float diff = 0.0f;
+			for (u64 i = warm - loop; i < warm; i++) diff = std::max(diff, std::abs(o[i] - o[i - loop]));
+			if (diff < TWEN_RENDER_SETTLED) break;
+		}
+		warm += loop;
+	}
+	StateData start, last;
+	m_graph->saveState(start);
+
+	std::atomic<bool> ok{ true };
+	for (u64 s = 1; s < segments; s++) {
+		pool.submit([&, s]() {
+			const u64 begin = s * length - fade, end = std::min(frames, (s + 1) * length);
+			Renderer segment(m_graph->sampleRate());
+			segment.shareSamples(*m_graph);
+			if (!segment.build(m_project) || !segment.m_graph->restoreState(start)) {
+				ok = false;
+				return;
+			}
+			segment.m_graph->seek(origin + begin);
+
+			Vec<float>& buf = out[s];
+			buf.resize(end - begin);
+			for (float& v : buf) v = segment.m_graph->sample();
+			if (s == segments - 1) segment.m_graph->saveState(last);
+		});
+	}
+	while (out[0].size() < length) out[0].push_back(step());
+	pool.wait();
+
+	if (!ok) {
+		LogE("Could not start the segments of a parallel render.");
+		return 0;
+	}
+
+	// Join the segments
+	Vec<float> result = std::move(out[0]);
+	result.reserve(frames);
+	for (u64 s = 1; s < segments; s++) {
+		const Vec<float>& buf = out[s];
+		float* tail = result.data() + result.size() - fade;
+		for (u64 i = 0; i < fade; i++) {
+			const float t = (float(i) + 0.5f) / float(fade);
+			tail[i] = Utils::lerp(tail[i], buf[i], t);
+		}
+		result.insert(result.end(), buf.begin() + fade, buf.end());
+		Vec<float>().swap(out[s]);
+	}
+
+	for (float s : result) {
+		m_peak = std::max(m_peak, std::abs(s));
+		m_sumSquares += double(s) * double(s);
+	}
+	m_rendered += result.size();
+
+	u64 written = 0;
+	while (written < result.size()) {
+		u64 n = std::min<u64>(result.size() - written, TWEN_RENDER_CHUNK_SIZE);
+		u64 w = file.writef(result.data() + written, n);
+		written += w;
+		if (w < n) break;
+	}
+
+	// Carry on from the end of the last segment
+	m_graph->restoreState(last);
+	m_position = frames;
+	return written;
+}
+
+float Renderer::rms() const {
+	return m_rendered == 0 ? 0.0f : float(std::sqrt(m_sumSquares / double(m_rendered)));
+}
+
+void Renderer::loadStreamed(NodeGraph& library) {
+	for (auto&& [name, sample] : library.sampleLibrary()) {
+		if (!sample->streamed()) continue;
+
+		TAudioFile snd(sample->path);
+		if (snd.channels() == 0) {
+			LogE("Could not open streamed sample: ", sample->path);
+			continue;
+		}
+
+		Vec<float> data(snd.frames());
+		data.resize(Sample::readMono(snd, data.data(), data.size()));
+		sample->data = std::make_shared<const Vec<float>>(std::move(data));
+		sample->path.clear();
+		sample->frames = 0;
+		library.prepareSample(sample.get());
+	}
+}
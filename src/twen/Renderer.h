@@ -0,0 +1,103 @@
+#ifndef TWEN_RENDERER_H
+#define TWEN_RENDERER_H
+
+#include "NodeGraph.h"
+#include "MidiFile.h"
+
+// Frames rendered between writes to the output file
+#define TWEN_RENDER_CHUNK_SIZE 4096
+// Overlap of the segments of a parallel render
+#define TWEN_RENDER_CROSSFADE 512
+// Largest difference (about -60 dB) between two loops for a patch to count as repeating
+#define TWEN_RENDER_SETTLED 1e-3f
+
+class TAudioFile;
+
+/// Runs a project without the editor, as fast as the CPU allows.
+class Renderer {
+public:
+	Renderer(float sampleRate = 44100.0f);
+
+	/// Makes every sample of library available, sharing the data instead of copying it.
+	void shareSamples(const NodeGraph& library);
+
+	/// Builds the graph from a project document (see TNodeGraph::toJSON).
+	/// Samples must be shared or added before, since nodes look them up on load.
+	bool build(const JSON& project);
+
+	/// Renders frames into file, which must be a mono writer. Returns the frames written.
+	u64 render(TAudioFile& file, u64 frames);
+
+	/// A node's output written to a file of its own, see render().
+	struct Stem {
+		Node* node;
+		TAudioFile* file;
+	};
+
+	/// render(), also writing the output of every stem's node (value * velocity
+	/// * gate, as the scopes show it) to its file, in the same pass and chunk by
+	/// chunk. Frozen loops that would keep a stem's node from running are thawed.
+	u64 render(TAudioFile& file, u64 frames, const Vec<Stem>& stems);
+
+	/// A node by its index in the project's "nodes" (a number) or by its label
+	/// (a string). Null, with an error logged, if there isn't exactly one.
+	Node* findNode(const JSON& ref) const;
+
+	/// Renders frames from the start, split into loop aligned segments
+	/// rendered on threads (0 = one per core). The first segment warms up
+	/// until a loop repeats the previous one, every other segment starts
+	/// from the state reached there (the same point of the loop) and
+	/// crossfades with the end of the previous one over TWEN_RENDER_CROSSFADE
+	/// frames. The joins are seamless for patches that settle into repeating
+	/// every loop, the others get a crossfade. Songs with tempo changes or a
+	/// loop region don't repeat, nor do MIDI performances: they render on
+	/// one thread. The whole output is kept in memory.
+	/// Returns the frames written, the graph ends up where render() would leave it.
+	u64 renderParallel(TAudioFile& file, u64 frames, u32 threads = 0);
+
+	/// Frames rendered since build().
+	u64 position() const { return m_position; }
+
+	/// Plays events (see MidiFile::events) into the graph's MIDI nodes, each at
+	/// its frame counted from build(). Call after build().
+	void midi(Vec<MidiEvent> events);
+
+	/// One full pass through the pattern from bar 0, in frames.
+	u64 loopLength() const;
+
+	NodeGraph& graph() { return *m_graph; }
+
+	/// The project's nodes, in file order (the order overrides refer to).
+	const Vec<Node*>& nodes() const { return m_nodes; }
+
+	float peak() const { return m_peak; }
+	float rms() const;
+
+	/// Loads the whole file of a streamed sample into memory. Offline rendering
+	/// runs faster than the disk streamer can keep up with.
+	static void loadStreamed(NodeGraph& library);
+
+private:
+	Ptr<NodeGraph> m_graph;
+	Vec<Node*> m_nodes;
+	JSON m_project;
+
+	u64 m_position{ 0 };
+	/// The state build() left, renderParallel() starts over from it.
+	StateData m_start;
+
+	Vec<MidiEvent> m_midi;
+	size_t m_midiNext{ 0 };
+	Vec<MidiReceiver*> m_receivers;
+	/// Skips the events before the current position.
+	void seekMidi();
+
+	/// One sample, delivering the MIDI events due at this position first.
+	float step();
+
+	float m_peak{ 0.0f };
+	double m_sumSquares{ 0.0 };
+	u64 m_rendered{ 0 };
+};
+
+#endif // TWEN_RENDERER_H
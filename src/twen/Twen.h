@@ -22,7 +22,7 @@
 
 namespace Twen {
 	inline void init() {
-#define GET(type, v, d) (json[v].is_null() ? d : json[v].get<type>())
+#define GET(type, v, d) (json.count(v) == 0 || json[v].is_null() ? d : json[v].get<type>())
 
 		NodeBuilder::registerType<ADSRNode>("Generators", TWEN_NODE_FAC {
 			return new ADSRNode(
@@ -31,7 +31,7 @@ namespace Twen {
 				GET(float, "s", 1.0f),
 				GET(float, "r", 0.0f)
 			);
-		});
+		}, Node::Resettable);
 
 		NodeBuilder::registerType<ArpNode>("Generators", TWEN_NODE_FAC {
 			return new ArpNode(
@@ -40,13 +40,13 @@ namespace Twen {
 				(ArpNode::Direction) GET(int, "dir", 0),
 				GET(float, "oct", 0)
 			);
-		});
+		}, Node::ControlRate);
 
 		NodeBuilder::registerType<SamplerNode>("Generators", TWEN_NODE_FAC {
 			return new SamplerNode(
 				GET(Str, "sample", "")
 			);
-		});
+		}, Node::Resettable);
 
 		NodeBuilder::registerType<ChorusNode>("Effects", TWEN_NODE_FAC {
 			return new ChorusNode(
@@ -76,33 +76,33 @@ namespace Twen {
 				GET(float, "a", 0),
 				GET(float, "b", 0)
 			);
-		});
+		}, Node::Stateless);
 
 		NodeBuilder::registerType<MixNode>("General", TWEN_NODE_FAC {
 			return new MixNode(GET(float, "fac", 0.5f));
-		});
+		}, Node::Stateless);
 
 		NodeBuilder::registerType<NoteNode>("General", TWEN_NODE_FAC {
 			return new NoteNode(
 				(Note) GET(int, "note", 0),
 				GET(float, "oct", 0)
 			);
-		});
+		}, Node::Stateless | Node::ControlRate);
 
 		NodeBuilder::registerType<HertzNode>("General", TWEN_NODE_FAC {
 			return new HertzNode();
-		});
+		}, Node::Stateless);
 
 		NodeBuilder::registerType<OscillatorNode>("Generators", TWEN_NODE_FAC {
 			return new OscillatorNode(
 				GET(float, "freq", 220.0f),
 				(OscillatorNode::WaveForm) GET(int, "wf", 0)
 			);
-		});
+		}, Node::Resettable);
 
 		NodeBuilder::registerType<OutNode>("General", TWEN_NODE_FAC {
 			return new OutNode();
-		});
+		}, Node::Sink);
 
 		NodeBuilder::registerType<RemapNode>("General", TWEN_NODE_FAC {
 			return new RemapNode(
@@ -111,21 +111,21 @@ namespace Twen {
 				GET(float, "nmin", 0.0f),
 				GET(float, "nmax", 1.0f)
 			);
-		});
+		}, Node::Stateless);
 
 		NodeBuilder::registerType<ReaderNode>("General", TWEN_NODE_FAC {
 			return new ReaderNode(GET(int, "idx", 0));
-		});
+		}, Node::ReadsStorage);
 
 		NodeBuilder::registerType<WriterNode>("General", TWEN_NODE_FAC {
 			return new WriterNode(GET(int, "idx", 0));
-		});
+		}, Node::Sink | Node::WritesStorage);
 
 		NodeBuilder::registerType<ValueNode>("General", TWEN_NODE_FAC {
 			return new ValueNode(
 				GET(float, "value", 0.0f)
 			);
-		});
+		}, Node::Stateless | Node::ControlRate);
 
 #undef GET
 	}
@@ -2,6 +2,7 @@
 #define TWEN_ADSR_H
 
 #include "Utils.h"
+#include "State.h"
 
 class ADSR {
 public:
@@ -77,6 +78,11 @@ public:
 	void gate(bool g);
 	float sample();
 
+	State state() const { return m_state; }
+
+	void saveState(StateWriter& w) const { w << m_state << m_out; }
+	void restoreState(StateReader& r) { r >> m_state >> m_out; }
+
 	void reset();
 
 private:
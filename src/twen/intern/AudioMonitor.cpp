@@ -0,0 +1,115 @@
+#include "AudioMonitor.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+AudioMonitor::~AudioMonitor() {
+	stopReporting();
+}
+
+void AudioMonitor::configure(u32 frames, float sampleRate) {
+	const double seconds = double(frames) / double(sampleRate);
+	m_budget = i64(seconds * 1e9);
+	// About one second worth of callbacks
+	m_smoothing = std::min(1.0f, float(seconds));
+	restart();
+}
+
+void AudioMonitor::begin() {
+	m_start = Clock::now();
+	if (m_restart.exchange(false, std::memory_order_relaxed)) m_started = false;
+
+	const i64 budget = m_budget.load(std::memory_order_relaxed);
+	if (m_started && budget > 0) {
+		i64 gap = std::chrono::duration_cast<std::chrono::nanoseconds>(m_start - m_lastStart).count();
+		if (gap > budget + budget / 2) {
+			m_late.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		float dev = float(std::abs(double(gap - budget)) / double(budget));
+		float avg = m_jitter.load(std::memory_order_relaxed);
+		m_jitter.store(avg + (dev - avg) * m_smoothing.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	m_lastStart = m_start;
+	m_started = true;
+}
+
+void AudioMonitor::end() {
+	const i64 budget = m_budget.load(std::memory_order_relaxed);
+	if (budget == 0) return;
+
+	i64 elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+	float load = float(double(elapsed) / double(budget));
+
+	m_callbacks.fetch_add(1, std::memory_order_relaxed);
+	if (load > 1.0f) {
+		m_overruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	u32 bucket = std::min(u32(load / TWEN_MONITOR_BUCKET_WIDTH), u32(TWEN_MONITOR_BUCKETS - 1));
+	m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	// Only the audio thread writes these, no need for a CAS loop
+	float avg = m_load.load(std::memory_order_relaxed);
+	m_load.store(avg + (load - avg) * m_smoothing.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	if (load > m_peakLoad.load(std::memory_order_relaxed)) {
+		m_peakLoad.store(load, std::memory_order_relaxed);
+	}
+}
+
+Arr<u64, TWEN_MONITOR_BUCKETS> AudioMonitor::histogram() const {
+	Arr<u64, TWEN_MONITOR_BUCKETS> ret;
+	for (u32 i = 0; i < TWEN_MONITOR_BUCKETS; i++) {
+		ret[i] = m_histogram[i].load(std::memory_order_relaxed);
+	}
+	return ret;
+}
+
+JSON AudioMonitor::toJSON() const {
+	JSON json;
+	json["budgetMs"] = budgetMs();
+	json["callbacks"] = callbacks();
+	json["overruns"] = overruns();
+	json["late"] = late();
+	json["load"] = load();
+	json["peakLoad"] = peakLoad();
+	json["jitter"] = jitter();
+	json["bucketWidth"] = TWEN_MONITOR_BUCKET_WIDTH;
+
+	auto hist = histogram();
+	json["histogram"] = Vec<u64>(hist.begin(), hist.end());
+	return json;
+}
+
+void AudioMonitor::startReporting(const Str& fileName, u32 intervalSeconds) {
+	stopReporting();
+	m_reporting = true;
+	m_reporter = std::thread([this, fileName, intervalSeconds]() {
+		const Str tmp = fileName + ".tmp";
+		auto next = Clock::now();
+		while (m_reporting) {
+			if (Clock::now() >= next) {
+				{
+					std::ofstream fp(tmp);
+					fp << std::setw(4) << toJSON() << std::endl;
+				}
+				// Readers never see a half written file
+				if (std::rename(tmp.c_str(), fileName.c_str()) != 0) {
+					LogE("Could not write the audio counters to ", fileName);
+				}
+				next += std::chrono::seconds(intervalSeconds);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	});
+	LogI("Writing audio counters to ", fileName, " every ", intervalSeconds, "s");
+}
+
+void AudioMonitor::stopReporting() {
+	m_reporting = false;
+	if (m_reporter.joinable()) m_reporter.join();
+}
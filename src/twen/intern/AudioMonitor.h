@@ -0,0 +1,75 @@
+#ifndef TWEN_AUDIO_MONITOR_H
+#define TWEN_AUDIO_MONITOR_H
+
+#include "Utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Load histogram buckets, 5% wide, the last one collects everything above 200%
+#define TWEN_MONITOR_BUCKETS 41
+#define TWEN_MONITOR_BUCKET_WIDTH 0.05f
+
+/// Measures how long each audio callback takes against its deadline
+/// (frames / sample rate). Everything the audio thread touches is atomic,
+/// so begin()/end() never block.
+class AudioMonitor {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	~AudioMonitor();
+
+	/// Sets the callback size, which defines the time budget.
+	void configure(u32 frames, float sampleRate);
+
+	/// The device was (re)opened: the next callback has no previous one to be late to.
+	void restart() { m_restart = true; }
+
+	/// Audio thread, at the start and the end of every callback.
+	void begin();
+	void end();
+
+	/// Render time / budget, smoothed over roughly the last second.
+	float load() const { return m_load.load(std::memory_order_relaxed); }
+	float peakLoad() const { return m_peakLoad.load(std::memory_order_relaxed); }
+	/// Smoothed deviation of the callback period from the budget, relative to the budget.
+	float jitter() const { return m_jitter.load(std::memory_order_relaxed); }
+	void resetPeak() { m_peakLoad = 0.0f; }
+
+	u64 callbacks() const { return m_callbacks.load(); }
+	/// Callbacks that took longer than their budget.
+	u64 overruns() const { return m_overruns.load(); }
+	/// Callbacks that started more than half a period late, i.e. the device
+	/// was starved before we were even called.
+	u64 late() const { return m_late.load(); }
+
+	float budgetMs() const { return float(m_budget.load()) / 1e6f; }
+
+	Arr<u64, TWEN_MONITOR_BUCKETS> histogram() const;
+
+	JSON toJSON() const;
+
+	/// Rewrites fileName with the counters every intervalSeconds, from a background thread.
+	void startReporting(const Str& fileName, u32 intervalSeconds = 10);
+	void stopReporting();
+
+private:
+	// Set from the main thread, possibly while the device is already running
+	std::atomic<i64> m_budget{ 0 };
+	std::atomic<float> m_smoothing{ 0.1f };
+	std::atomic<bool> m_restart{ false };
+
+	// Audio thread only
+	Clock::time_point m_start, m_lastStart;
+	bool m_started{ false };
+
+	std::atomic<float> m_load{ 0.0f }, m_peakLoad{ 0.0f }, m_jitter{ 0.0f };
+	std::atomic<u64> m_callbacks{ 0 }, m_overruns{ 0 }, m_late{ 0 };
+	Arr<std::atomic<u64>, TWEN_MONITOR_BUCKETS> m_histogram{};
+
+	std::thread m_reporter;
+	std::atomic<bool> m_reporting{ false };
+};
+
+#endif // TWEN_AUDIO_MONITOR_H
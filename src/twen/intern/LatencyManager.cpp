@@ -0,0 +1,93 @@
+#include "LatencyManager.h"
+
+#include "Log.h"
+
+#include <algorithm>
+
+// How long a size that overran stays off limits
+#define LATENCY_FLOOR_SECONDS 60.0f
+
+LatencyManager::LatencyManager(AudioMonitor& monitor)
+	: m_monitor(monitor)
+{
+	m_lastChange = m_lastOverrun = m_floorSet = AudioMonitor::Clock::now();
+}
+
+void LatencyManager::preset(Preset p) {
+	m_preset = p;
+	m_presetChanged = true;
+	m_pinned = false;
+	m_floor = TWEN_LATENCY_MIN_FRAMES;
+}
+
+void LatencyManager::pin(u32 frames) {
+	m_pinned = true;
+	m_floor = std::max(frames, u32(TWEN_LATENCY_MIN_FRAMES));
+	m_floorSet = AudioMonitor::Clock::now();
+	LogW("Audio buffer pinned to ", frames, " frames.");
+}
+
+u32 LatencyManager::presetFrames(Preset p) {
+	switch (p) {
+		case LowLatency: return 128;
+		case Balanced: return 512;
+		case Safe: return 2048;
+		default: return 0;
+	}
+}
+
+const char* LatencyManager::presetName(Preset p) {
+	switch (p) {
+		case Adaptive: return "Adaptive";
+		case LowLatency: return "Low Latency";
+		case Balanced: return "Balanced";
+		case Safe: return "Safe";
+		default: return "";
+	}
+}
+
+u32 LatencyManager::update(u32 frames) {
+	using namespace std::chrono;
+	auto now = AudioMonitor::Clock::now();
+
+	if (m_presetChanged) {
+		m_presetChanged = false;
+		u32 target = m_preset == Adaptive ? frames : presetFrames(m_preset);
+		return target != frames ? changeTo(target) : 0;
+	}
+	if (m_preset != Adaptive || m_pinned) return 0;
+
+	u64 overruns = m_monitor.overruns();
+	bool overran = overruns > m_overruns;
+	m_overruns = overruns;
+	if (overran) m_lastOverrun = now;
+
+	if (duration<float>(now - m_floorSet).count() > LATENCY_FLOOR_SECONDS) {
+		m_floor = TWEN_LATENCY_MIN_FRAMES;
+	}
+
+	if (duration<float>(now - m_lastChange).count() < settleSeconds) return 0;
+
+	// Jitter eats into the budget just like render time does
+	const float pressure = m_monitor.load() + m_monitor.jitter();
+
+	if ((overran || pressure > growLoad) && frames < TWEN_LATENCY_MAX_FRAMES) {
+		m_floor = frames * 2;
+		m_floorSet = now;
+		return changeTo(frames * 2);
+	}
+
+	const bool quiet = duration<float>(now - m_lastOverrun).count() > holdSeconds;
+	if (quiet && pressure < shrinkLoad && frames / 2 >= std::max(m_floor, u32(TWEN_LATENCY_MIN_FRAMES))) {
+		return changeTo(frames / 2);
+	}
+
+	return 0;
+}
+
+u32 LatencyManager::changeTo(u32 frames) {
+	m_lastChange = AudioMonitor::Clock::now();
+	m_overruns = m_monitor.overruns();
+	LogI("Audio buffer: ", frames, " frames (", presetName(m_preset), ")");
+	return frames;
+}
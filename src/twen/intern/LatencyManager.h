@@ -0,0 +1,60 @@
+#ifndef TWEN_LATENCY_MANAGER_H
+#define TWEN_LATENCY_MANAGER_H
+
+#include "AudioMonitor.h"
+
+#define TWEN_LATENCY_MIN_FRAMES 64
+#define TWEN_LATENCY_MAX_FRAMES 4096
+
+/// Picks the audio buffer size. With the Adaptive preset it looks for the
+/// smallest power of two the current patch can sustain, using the monitor's
+/// load and jitter; the other presets are fixed sizes.
+class LatencyManager {
+public:
+	enum Preset {
+		Adaptive = 0,
+		LowLatency,
+		Balanced,
+		Safe
+	};
+
+	LatencyManager(AudioMonitor& monitor);
+
+	Preset preset() const { return m_preset; }
+	void preset(Preset p);
+
+	static u32 presetFrames(Preset p);
+	static const char* presetName(Preset p);
+
+	/// Main thread, called regularly (e.g. once per GUI frame). Returns the
+	/// buffer size the device should be reopened with, or 0 to keep frames.
+	u32 update(u32 frames);
+
+	/// The device didn't take the size asked for: stays at frames, with no
+	/// more changes until the preset is picked again.
+	void pin(u32 frames);
+
+	/// Load (plus jitter headroom) above which the buffer grows, and below
+	/// which it may shrink. The gap between them is the hysteresis.
+	float growLoad{ 0.75f }, shrinkLoad{ 0.4f };
+
+	/// Seconds without overruns before shrinking, and after a change before
+	/// deciding again.
+	float holdSeconds{ 5.0f }, settleSeconds{ 2.0f };
+
+private:
+	AudioMonitor& m_monitor;
+	Preset m_preset{ Adaptive };
+	bool m_presetChanged{ false }, m_pinned{ false };
+
+	AudioMonitor::Clock::time_point m_lastChange, m_lastOverrun;
+	u64 m_overruns{ 0 };
+
+	// Sizes that overran are not tried again for a while
+	u32 m_floor{ TWEN_LATENCY_MIN_FRAMES };
+	AudioMonitor::Clock::time_point m_floorSet;
+
+	u32 changeTo(u32 frames);
+};
+
+#endif // TWEN_LATENCY_MANAGER_H
@@ -1,15 +1,170 @@
 #include "Log.h"
-#include <cstdarg>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 Out Log::_out = nullptr;
 bool Log::_colorize = true;
 
+namespace {
+	struct Ring {
+		std::atomic<bool> used{ false };
+		std::atomic<uint64_t> read{ 0 }, write{ 0 };
+		Log::Record records[TWEN_LOG_RING_SIZE];
+	};
+
+	Ring rings[TWEN_LOG_THREADS];
+	std::atomic<uint64_t> sequence{ 0 }, droppedCount{ 0 };
+
+	// Formatting and output, shared by the writer thread and synchronous calls
+	std::recursive_mutex outputLock;
+
+	struct Pending { const Log::Record* rec; Ring* ring; };
+	std::vector<Pending> pending;
+
+	/// Gives the ring back when its thread ends.
+	struct ThreadRing {
+		Ring* ring{ nullptr };
+		bool claimed{ false }, realtime{ false };
+
+		~ThreadRing() {
+			if (ring != nullptr) ring->used.store(false, std::memory_order_release);
+		}
+	};
+	thread_local ThreadRing threadRing;
+
+	// Threads that found no free ring log synchronously through this one
+	thread_local Log::Record fallbackRecord;
+
+	int64_t now() {
+		using namespace std::chrono;
+		return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+	}
+}
+
+/// Background thread that drains the rings.
+class LogWriter {
+public:
+	LogWriter() {
+		m_thread = std::thread([this]() {
+			while (m_active.load()) {
+				Log::drain();
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+			Log::drain();
+		});
+	}
+
+	~LogWriter() {
+		m_active = false;
+		m_thread.join();
+	}
+
+	static void start() {
+		static LogWriter writer;
+	}
+
+private:
+	std::thread m_thread;
+	std::atomic<bool> m_active{ true };
+};
+
 void Log::redirect(Out out, bool colorize) {
+	std::lock_guard<std::recursive_mutex> lk(outputLock);
+	drain();
 	_out = out;
 	_colorize = colorize;
 }
 
+Log::Record* Log::acquire() {
+	ThreadRing& tr = threadRing;
+	if (!tr.claimed) {
+		tr.claimed = true;
+		LogWriter::start();
+		for (Ring& ring : rings) {
+			bool expected = false;
+			if (ring.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+				tr.ring = &ring;
+				break;
+			}
+		}
+	}
+
+	if (tr.ring == nullptr) return &fallbackRecord;
+
+	Ring& ring = *tr.ring;
+	const uint64_t w = ring.write.load(std::memory_order_relaxed);
+	if (w - ring.read.load(std::memory_order_acquire) >= TWEN_LOG_RING_SIZE) {
+		if (tr.realtime) {
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		// Everyone else can afford to wait for the writer
+		drain();
+	}
+	return &ring.records[w % TWEN_LOG_RING_SIZE];
+}
+
+void Log::commit(Record* rec) {
+	rec->seq = sequence.fetch_add(1, std::memory_order_relaxed);
+	rec->time = now();
+
+	if (rec == &fallbackRecord) {
+		std::lock_guard<std::recursive_mutex> lk(outputLock);
+		drain();
+		print(*rec);
+		return;
+	}
+
+	Ring& ring = *threadRing.ring;
+	ring.write.store(ring.write.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Log::drain() {
+	std::lock_guard<std::recursive_mutex> lk(outputLock);
+
+	pending.clear();
+
+	uint64_t ends[TWEN_LOG_THREADS];
+	for (int i = 0; i < TWEN_LOG_THREADS; i++) {
+		Ring& ring = rings[i];
+		ends[i] = ring.write.load(std::memory_order_acquire);
+		for (uint64_t r = ring.read.load(std::memory_order_relaxed); r < ends[i]; r++) {
+			pending.push_back({ &ring.records[r % TWEN_LOG_RING_SIZE], &ring });
+		}
+	}
+	if (pending.empty()) return;
+
+	// Keep the order in which the messages were logged, across threads
+	std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+		return a.rec->seq < b.rec->seq;
+	});
+	for (const Pending& p : pending) {
+		print(*p.rec);
+	}
+
+	for (int i = 0; i < TWEN_LOG_THREADS; i++) {
+		rings[i].read.store(ends[i], std::memory_order_release);
+	}
+}
+
+void Log::flush() {
+	drain();
+	if (_out != nullptr) _out->flush();
+}
+
+void Log::realtimeThread() {
+	threadRing.realtime = true;
+}
+
+uint64_t Log::dropped() {
+	return droppedCount.load();
+}
+
 void Log::log(
 	LogLevel level,
 	const char* file,
@@ -17,8 +172,52 @@ void Log::log(
 	int line,
 	const std::string& msg
 ) {
+	std::lock_guard<std::recursive_mutex> lk(outputLock);
+	drain();
+	print(level, now(), file, function, line, msg);
+}
+
+void Log::print(const Record& rec) {
+	std::ostringstream oss;
+
+	uint16_t pos = 0;
+	while (pos < rec.size) {
+		_intern::ArgType type = _intern::ArgType(rec.data[pos++]);
+		switch (type) {
+			case _intern::ArgInt: {
+				int64_t v; std::memcpy(&v, rec.data + pos, sizeof(v)); pos += sizeof(v);
+				oss << v;
+			} break;
+			case _intern::ArgUInt: {
+				uint64_t v; std::memcpy(&v, rec.data + pos, sizeof(v)); pos += sizeof(v);
+				oss << v;
+			} break;
+			case _intern::ArgReal: {
+				double v; std::memcpy(&v, rec.data + pos, sizeof(v)); pos += sizeof(v);
+				oss << v;
+			} break;
+			case _intern::ArgBool: {
+				bool v; std::memcpy(&v, rec.data + pos, sizeof(v)); pos += sizeof(v);
+				oss << v;
+			} break;
+			case _intern::ArgChar: {
+				oss << rec.data[pos++];
+			} break;
+			case _intern::ArgString: {
+				uint16_t len; std::memcpy(&len, rec.data + pos, 2); pos += 2;
+				oss.write(rec.data + pos, len); pos += len;
+			} break;
+		}
+	}
+	if (rec.truncated) oss << "...";
+
+	const Site& site = *rec.site;
+	print(site.level, rec.time, site.file, site.function, site.line, oss.str());
+}
+
+void Log::print(LogLevel level, int64_t time, const char* file, const char* function, int line, const std::string& msg) {
 	if (_out == nullptr)
-		redirect(&std::cout);
+		_out = &std::cout;
 
 #define L_OUT (*_out)
 
@@ -34,10 +233,10 @@ void Log::log(
 	o << msg; \
 }
 
-	time_t now = time(0);
+	time_t secs = time_t(time / 1000000000);
 	struct tm tstruct;
 	char timeBuf[80] = {0};
-	tstruct = *localtime(&now);
+	tstruct = *localtime(&secs);
 	strftime(timeBuf, sizeof(timeBuf), "%m/%d/%Y %X", &tstruct);
 
 	if (_colorize) {
@@ -61,4 +260,4 @@ void Log::log(
 	L_OUT << " [" << fileS << "(" << function << ")@" << line << "] " << msg << std::endl;
 
 #undef L_OUT
-}
\ No newline at end of file
+}
@@ -1,8 +1,13 @@
 #ifndef TWEN_LOG_H
 #define TWEN_LOG_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 
 #include "termcolor/termcolor.hpp"
@@ -11,6 +16,12 @@ using Out = std::ostream*;
 
 #define STR(x) #x
 
+// Every thread that logs gets one of these rings
+#define TWEN_LOG_THREADS 32
+#define TWEN_LOG_RING_SIZE 256
+// Bytes of encoded arguments per record, longer messages are truncated
+#define TWEN_LOG_PAYLOAD 224
+
 namespace _intern {
 	template<typename T>
 	inline std::string Stringfy(const T& value) {
@@ -23,8 +34,70 @@ namespace _intern {
 	inline std::string Stringfy(const T& value, const Args&... args) {
 		return Stringfy(value) + Stringfy(args...);
 	}
+
+	enum ArgType : uint8_t {
+		ArgInt = 0,
+		ArgUInt,
+		ArgReal,
+		ArgBool,
+		ArgChar,
+		ArgString
+	};
+
+	/// Packs log arguments into a record, as type tag + raw bytes.
+	struct Encoder {
+		char* data;
+		uint16_t size, capacity;
+		bool truncated;
+
+		template<typename T>
+		void put(ArgType type, const T& value) {
+			if (size + 1 + sizeof(T) > capacity) { truncated = true; return; }
+			data[size++] = char(type);
+			std::memcpy(data + size, &value, sizeof(T));
+			size += uint16_t(sizeof(T));
+		}
+
+		void string(std::string_view str) {
+			if (size + 3 > capacity) { truncated = true; return; }
+			uint16_t len = uint16_t(std::min<size_t>(str.size(), capacity - size - 3));
+			if (len < str.size()) truncated = true;
+			data[size++] = char(ArgString);
+			std::memcpy(data + size, &len, 2);
+			std::memcpy(data + size + 2, str.data(), len);
+			size += 2 + len;
+		}
+	};
+
+	template<typename T>
+	inline void Encode(Encoder& enc, const T& value) {
+		using D = std::decay_t<T>;
+		if constexpr (std::is_same_v<D, bool>) {
+			enc.put(ArgBool, value);
+		} else if constexpr (std::is_same_v<D, char> || std::is_same_v<D, signed char> || std::is_same_v<D, unsigned char>) {
+			enc.put(ArgChar, char(value));
+		} else if constexpr ((std::is_integral_v<D> && std::is_signed_v<D>) || std::is_enum_v<D>) {
+			enc.put(ArgInt, int64_t(value));
+		} else if constexpr (std::is_integral_v<D>) {
+			enc.put(ArgUInt, uint64_t(value));
+		} else if constexpr (std::is_floating_point_v<D>) {
+			enc.put(ArgReal, double(value));
+		} else if constexpr (std::is_convertible_v<const T&, const char*>) {
+			const char* str = value;
+			enc.string(str != nullptr ? str : "(null)");
+		} else if constexpr (std::is_same_v<D, std::string> || std::is_same_v<D, std::string_view>) {
+			enc.string(std::string_view(value));
+		} else {
+			// Anything else goes through its operator<<, which allocates.
+			// Keep these out of the audio thread.
+			enc.string(Stringfy(value));
+		}
+	}
 }
 
+/// Asynchronous logger. A log call only encodes its arguments into a
+/// preallocated per-thread ring (no locks, no allocation for numbers and
+/// strings); a background thread formats and writes them.
 class Log {
 public:
 	enum LogLevel {
@@ -34,8 +107,39 @@ public:
 		Assert
 	};
 
+	/// Where a message comes from. One static instance per call site.
+	struct Site {
+		LogLevel level;
+		const char* file;
+		const char* function;
+		int line;
+	};
+
+	struct Record {
+		uint64_t seq;
+		int64_t time;
+		const Site* site;
+		uint16_t size;
+		bool truncated;
+		char data[TWEN_LOG_PAYLOAD];
+	};
+
 	static void redirect(Out out, bool colorize=true);
 
+	template<typename... Args>
+	static void write(const Site& site, const Args&... args) {
+		Record* rec = acquire();
+		if (rec == nullptr) return;
+
+		_intern::Encoder enc{ rec->data, 0, TWEN_LOG_PAYLOAD, false };
+		(_intern::Encode(enc, args), ...);
+		rec->site = &site;
+		rec->size = enc.size;
+		rec->truncated = enc.truncated;
+		commit(rec);
+	}
+
+	/// Writes a message synchronously, after everything still queued.
 	static void log(
 		LogLevel level,
 		const char* file,
@@ -44,9 +148,27 @@ public:
 		const std::string& msg
 	);
 
+	/// Blocks until every queued message has been written.
+	static void flush();
+
+	/// Marks the calling thread as real-time (audio callback, engine threads):
+	/// when its ring is full, messages are dropped instead of waiting.
+	static void realtimeThread();
+
+	/// Messages lost because a real-time thread's ring was full.
+	static uint64_t dropped();
+
 private:
 	static Out _out;
 	static bool _colorize;
+
+	static Record* acquire();
+	static void commit(Record* rec);
+	static void drain();
+	static void print(const Record& rec);
+	static void print(LogLevel level, int64_t time, const char* file, const char* function, int line, const std::string& msg);
+
+	friend class LogWriter;
 };
 
 #ifdef __PRETTY_FUNCTION__
@@ -61,12 +183,33 @@ private:
 #define SEP '/'
 #endif
 
-#define LogPrint(lvl, ...) Log::log(lvl, __FILE__, FN, __LINE__, _intern::Stringfy(__VA_ARGS__))
+#define LogPrint(lvl, ...) do { \
+	static const Log::Site _logSite{ lvl, __FILE__, FN, __LINE__ }; \
+	Log::write(_logSite, __VA_ARGS__); \
+} while (0)
+
+// Define TWEN_LOG_NO_INFO / _WARNING / _ERROR (see the TWEN_LOG_* CMake
+// options) to compile the matching calls out entirely.
+#ifndef TWEN_LOG_NO_INFO
 #define LogI(...) LogPrint(Log::Info, __VA_ARGS__)
+#else
+#define LogI(...) ((void)0)
+#endif
+
+#ifndef TWEN_LOG_NO_WARNING
 #define LogW(...) LogPrint(Log::Warning, __VA_ARGS__)
+#else
+#define LogW(...) ((void)0)
+#endif
+
+#ifndef TWEN_LOG_NO_ERROR
 #define LogE(...) LogPrint(Log::Error, __VA_ARGS__)
+#else
+#define LogE(...) ((void)0)
+#endif
+
 #define LogAssert(cond, ...) if (!(cond)) { \
-	LogPrint(Log::Assert, __VA_ARGS__); \
+	Log::log(Log::Assert, __FILE__, FN, __LINE__, _intern::Stringfy(__VA_ARGS__)); \
 	abort(); \
 }
 
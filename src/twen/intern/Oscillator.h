@@ -2,6 +2,7 @@
 #define TWEN_OSCILLATOR_H
 
 #include "Utils.h"
+#include "State.h"
 
 class Oscillator {
 public:
@@ -43,6 +44,9 @@ public:
 
 	void reset() { m_phase = 0; }
 
+	void saveState(StateWriter& w) const { w << m_phase << m_noise; }
+	void restoreState(StateReader& r) { r >> m_phase >> m_noise; }
+
 private:
 	float m_sampleRate, m_phase, m_amplitude, m_frequency, m_noise;
 	WaveForm m_waveform;
@@ -0,0 +1,106 @@
+#include "PeakPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void PeakPyramid::add(const float* data, u64 count) {
+	for (u64 i = 0; i < count; i++) {
+		const float v = data[i];
+		if (m_pendingFrames == 0) {
+			m_pending = { v, v, 0.0f };
+		} else {
+			m_pending.min = std::min(m_pending.min, v);
+			m_pending.max = std::max(m_pending.max, v);
+		}
+		m_pending.ms += v * v;
+
+		if (++m_pendingFrames == TWEN_PEAK_BASE_FRAMES) {
+			m_pending.ms /= TWEN_PEAK_BASE_FRAMES;
+			push(0, m_pending);
+			m_pendingFrames = 0;
+		}
+	}
+	m_frames += count;
+}
+
+void PeakPyramid::push(u32 level, const Bin& bin) {
+	if (level == m_levels.size()) m_levels.emplace_back();
+
+	Vec<Bin>& bins = m_levels[level];
+	bins.push_back(bin);
+	if (bins.size() % 2 == 0) {
+		const Bin& a = bins[bins.size() - 2];
+		push(level + 1, { std::min(a.min, bin.min), std::max(a.max, bin.max), (a.ms + bin.ms) * 0.5f });
+	}
+}
+
+PeakPyramid::Peak PeakPyramid::range(u64 from, u64 to) const {
+	// Bin range on the finest level, at least one bin
+	u64 i = from / TWEN_PEAK_BASE_FRAMES;
+	u64 j = std::max(i + 1, (to + TWEN_PEAK_BASE_FRAMES - 1) / TWEN_PEAK_BASE_FRAMES);
+
+	float mn = 0.0f, mx = 0.0f;
+	double sq = 0.0, frames = 0.0;
+	bool first = true;
+	auto merge = [&](const Bin& b, double n) {
+		mn = first ? b.min : std::min(mn, b.min);
+		mx = first ? b.max : std::max(mx, b.max);
+		sq += double(b.ms) * n;
+		frames += n;
+		first = false;
+	};
+
+	const u64 complete = m_levels.empty() ? 0 : m_levels[0].size();
+	const u64 end = std::min(j, complete);
+	while (i < end) {
+		// Largest aligned bin that fits in what is left
+		u32 k = 0;
+		while (k + 1 < m_levels.size() &&
+			(i & ((u64(2) << k) - 1)) == 0 &&
+			i + (u64(2) << k) <= end &&
+			(i >> (k + 1)) < m_levels[k + 1].size())
+		{
+			k++;
+		}
+		merge(m_levels[k][i >> k], double(u64(TWEN_PEAK_BASE_FRAMES) << k));
+		i += u64(1) << k;
+	}
+
+	// The bin still being filled
+	if (j > complete && m_pendingFrames > 0) {
+		Bin b = m_pending;
+		b.ms /= m_pendingFrames;
+		merge(b, m_pendingFrames);
+	}
+
+	if (first) return { 0.0f, 0.0f, 0.0f };
+	return { mn, mx, float(std::sqrt(sq / frames)) };
+}
+
+void PeakPyramid::columns(u64 from, u64 to, u32 count, Peak* out) const {
+	to = std::min(to, m_frames);
+	if (count == 0) return;
+	if (to <= from) {
+		std::fill(out, out + count, Peak{ 0.0f, 0.0f, 0.0f });
+		return;
+	}
+
+	const double step = double(to - from) / count;
+	for (u32 c = 0; c < count; c++) {
+		u64 a = from + u64(c * step);
+		u64 b = std::max(a + 1, from + u64((c + 1) * step));
+		out[c] = range(a, b);
+	}
+}
+
+Vec<PeakPyramid::Peak> PeakPyramid::columns(u64 from, u64 to, u32 count) const {
+	Vec<Peak> ret(count);
+	columns(from, to, count, ret.data());
+	return ret;
+}
+
+Ptr<PeakPyramid> PeakPyramid::build(const float* data, u64 count) {
+	Ptr<PeakPyramid> ret = Ptr<PeakPyramid>(new PeakPyramid());
+	ret->add(data, count);
+	return ret;
+}
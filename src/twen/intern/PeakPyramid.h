@@ -0,0 +1,45 @@
+#ifndef TWEN_PEAK_PYRAMID_H
+#define TWEN_PEAK_PYRAMID_H
+
+#include "Utils.h"
+
+// Frames per bin on the finest level, every level above halves the bin count
+#define TWEN_PEAK_BASE_FRAMES 64
+
+/// Min/max/RMS overview of an audio signal at every power-of-two resolution,
+/// built incrementally. Waveform views read one value per on-screen column,
+/// so drawing costs O(pixels) no matter how long the audio is.
+class PeakPyramid {
+public:
+	struct Peak {
+		float min, max, rms;
+	};
+
+	/// Appends audio. Only complete bins are merged into the coarser levels.
+	void add(const float* data, u64 count);
+
+	u64 frames() const { return m_frames; }
+
+	/// Summarizes [from, to) in count columns.
+	void columns(u64 from, u64 to, u32 count, Peak* out) const;
+	Vec<Peak> columns(u64 from, u64 to, u32 count) const;
+
+	/// Pyramid of a whole buffer.
+	static Ptr<PeakPyramid> build(const float* data, u64 count);
+
+private:
+	// Mean square, so equal sized bins merge by averaging
+	struct Bin {
+		float min, max, ms;
+	};
+
+	Vec<Vec<Bin>> m_levels;
+	Bin m_pending{ 0.0f, 0.0f, 0.0f };
+	u32 m_pendingFrames{ 0 };
+	u64 m_frames{ 0 };
+
+	void push(u32 level, const Bin& bin);
+	Peak range(u64 from, u64 to) const;
+};
+
+#endif // TWEN_PEAK_PYRAMID_H
@@ -0,0 +1,104 @@
+#include "Recorder.h"
+
+#include "Log.h"
+#include "TAudio.h"
+
+#include <algorithm>
+#include <chrono>
+
+Recorder::Recorder() {
+	m_ring.resize(TWEN_RECORDER_RING_SIZE, 0.0f);
+}
+
+Recorder::~Recorder() {
+	stop();
+}
+
+bool Recorder::start(const Str& fileName, u32 sampleRate) {
+	stop();
+
+	m_file = Ptr<TAudioFile>(new TAudioFile(fileName, true, sampleRate, 1, TAudioFile::PCM16));
+	if (!m_file->valid()) {
+		LogE("Could not record to: ", fileName);
+		m_file.reset();
+		return false;
+	}
+	m_file->dither(true);
+	m_fileName = fileName;
+
+	{
+		std::lock_guard<std::mutex> lk(m_overviewLock);
+		m_peaks = PeakPyramid();
+	}
+
+	// Samples pushed after the last take's final drain are not part of this one
+	m_start = m_write.load();
+	m_read.store(m_start, std::memory_order_release);
+	m_dropped = 0;
+	m_active.store(true, std::memory_order_release);
+	m_thread = std::thread(&Recorder::run, this);
+	return true;
+}
+
+void Recorder::stop() {
+	if (!m_thread.joinable()) return;
+	m_active.store(false, std::memory_order_release);
+	m_thread.join();
+
+	m_file->close();
+	m_file.reset();
+
+	if (m_dropped > 0) {
+		LogE("Recording dropped ", m_dropped.load(), " samples, the disk could not keep up.");
+	}
+}
+
+void Recorder::write(float sample) {
+	if (!m_active.load(std::memory_order_acquire)) return;
+
+	u64 w = m_write.load(std::memory_order_relaxed);
+	if (w - m_read.load(std::memory_order_acquire) >= TWEN_RECORDER_RING_SIZE) {
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	m_ring[w % TWEN_RECORDER_RING_SIZE] = sample;
+	m_write.store(w + 1, std::memory_order_release);
+}
+
+u64 Recorder::frames() const {
+	return m_write.load(std::memory_order_relaxed) - m_start;
+}
+
+Vec<PeakPyramid::Peak> Recorder::overview(u32 columns) const {
+	std::lock_guard<std::mutex> lk(m_overviewLock);
+	return m_peaks.columns(0, m_peaks.frames(), columns);
+}
+
+void Recorder::run() {
+	while (m_active.load(std::memory_order_acquire)) {
+		drain();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	// The audio thread may have pushed a few more before seeing the flag
+	drain();
+}
+
+void Recorder::drain() {
+	u64 r = m_read.load(std::memory_order_relaxed);
+	u64 w = m_write.load(std::memory_order_acquire);
+
+	while (r < w) {
+		// Contiguous part of the ring, at most one chunk
+		u64 begin = r % TWEN_RECORDER_RING_SIZE;
+		u64 n = std::min<u64>({ w - r, TWEN_RECORDER_CHUNK_SIZE, TWEN_RECORDER_RING_SIZE - begin });
+
+		m_file->writef(&m_ring[begin], n);
+		{
+			std::lock_guard<std::mutex> lk(m_overviewLock);
+			m_peaks.add(&m_ring[begin], n);
+		}
+
+		r += n;
+		m_read.store(r, std::memory_order_release);
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef TWEN_RECORDER_H
+#define TWEN_RECORDER_H
+
+#include "Utils.h"
+#include "PeakPyramid.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// About 3 seconds at 44.1 kHz, the writer thread drains it far more often
+#define TWEN_RECORDER_RING_SIZE (1 << 17)
+#define TWEN_RECORDER_CHUNK_SIZE 4096
+
+class TAudioFile;
+
+/// Records the engine output to a WAV file of any length. The audio thread
+/// pushes samples into a lock-free ring and a writer thread appends them to
+/// disk in chunks, so memory use does not grow with the take.
+class Recorder {
+public:
+	Recorder();
+	~Recorder();
+
+	/// Starts a new take. Returns false if the file could not be created.
+	bool start(const Str& fileName, u32 sampleRate);
+
+	/// Flushes everything recorded so far and closes the file.
+	void stop();
+
+	/// Audio thread. Drops the sample (and counts it) if the writer falls behind.
+	void write(float sample);
+
+	bool recording() const { return m_active.load(std::memory_order_relaxed); }
+
+	/// Frames recorded in the current (or last) take.
+	u64 frames() const;
+	u64 dropped() const { return m_dropped.load(); }
+
+	const Str& fileName() const { return m_fileName; }
+
+	/// Waveform overview of the take, one peak per column.
+	Vec<PeakPyramid::Peak> overview(u32 columns) const;
+
+private:
+	Str m_fileName;
+	Ptr<TAudioFile> m_file;
+
+	Vec<float> m_ring;
+	std::atomic<u64> m_read{ 0 }, m_write{ 0 };
+	u64 m_start{ 0 };
+	std::atomic<u64> m_dropped{ 0 };
+	std::atomic<bool> m_active{ false };
+
+	std::thread m_thread;
+
+	// Built by the writer thread as the take is written
+	mutable std::mutex m_overviewLock;
+	PeakPyramid m_peaks;
+
+	void run();
+	void drain();
+};
+
+#endif // TWEN_RECORDER_H
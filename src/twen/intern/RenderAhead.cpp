@@ -0,0 +1,117 @@
+#include "RenderAhead.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+RenderAhead::~RenderAhead() {
+	stop();
+}
+
+void RenderAhead::start(const RenderFn& render, u32 aheadFrames) {
+	stop();
+
+	m_render = render;
+	m_ahead = std::max(1u, (aheadFrames + TWEN_RENDER_AHEAD_BLOCK - 1) / TWEN_RENDER_AHEAD_BLOCK) * TWEN_RENDER_AHEAD_BLOCK;
+
+	// A power of two in blocks, so a block never wraps around the ring
+	u32 size = TWEN_RENDER_AHEAD_BLOCK;
+	while (size < m_ahead) size *= 2;
+	m_ring.assign(size, 0.0f);
+	m_read = m_write = 0;
+	m_underruns = 0;
+
+	// The caller may be rendering directly right now, so the engine thread
+	// waits until the audio thread takes the resume request.
+	m_bypass = true;
+	m_flushed = true;
+	m_engineIdle = true;
+	m_resume = true;
+
+	m_active = true;
+	m_thread = std::thread(&RenderAhead::run, this);
+	m_running = true;
+
+	LogI("Rendering ", m_ahead, " frames ahead");
+}
+
+void RenderAhead::stop() {
+	if (!m_thread.joinable()) return;
+	m_active = false;
+	m_thread.join();
+	// The audio thread keeps reading the ring until this point, and renders
+	// directly from the next callback on.
+	m_running = false;
+}
+
+bool RenderAhead::read(float* out, u32 frames) {
+	if (!m_running.load()) return false;
+
+	// Safe here: the audio thread is not rendering between callbacks
+	if (m_resume.exchange(false)) {
+		m_bypass = false;
+	}
+
+	if (m_bypass.load()) {
+		if (m_engineIdle.load()) {
+			if (!m_flushed) {
+				m_read.store(m_write.load(std::memory_order_acquire), std::memory_order_release);
+				m_flushed = true;
+			}
+			return false;
+		}
+		// The engine thread is still finishing a block, play what we have
+	}
+
+	const u64 r = m_read.load(std::memory_order_relaxed);
+	const u64 available = m_write.load(std::memory_order_acquire) - r;
+	const u64 size = m_ring.size();
+
+	u32 n = u32(std::min<u64>(frames, available));
+	u64 begin = r % size;
+	u32 first = u32(std::min<u64>(n, size - begin));
+	std::memcpy(out, &m_ring[begin], first * sizeof(float));
+	std::memcpy(out + first, &m_ring[0], (n - first) * sizeof(float));
+
+	if (n < frames) {
+		std::fill(out + n, out + frames, 0.0f);
+		m_underruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	m_read.store(r + n, std::memory_order_release);
+	return true;
+}
+
+void RenderAhead::bypass() {
+	if (m_bypass.load()) return;
+	m_bypass = true;
+	m_flushed = false;
+}
+
+void RenderAhead::run() {
+	Log::realtimeThread();
+
+	const u64 size = m_ring.size();
+	while (m_active.load()) {
+		// Paired with read(): either the audio thread sees us busy, or we see the bypass
+		m_engineIdle = false;
+		if (m_bypass.load()) {
+			m_engineIdle = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		const u64 w = m_write.load(std::memory_order_relaxed);
+		if (w - m_read.load(std::memory_order_acquire) + TWEN_RENDER_AHEAD_BLOCK > m_ahead) {
+			m_engineIdle = true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		m_render(&m_ring[w % size], TWEN_RENDER_AHEAD_BLOCK);
+		m_write.store(w + TWEN_RENDER_AHEAD_BLOCK, std::memory_order_release);
+	}
+	m_engineIdle = true;
+}
@@ -0,0 +1,69 @@
+#ifndef TWEN_RENDER_AHEAD_H
+#define TWEN_RENDER_AHEAD_H
+
+#include "Utils.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#define TWEN_RENDER_AHEAD_BLOCK 256
+#define TWEN_RENDER_AHEAD_FRAMES 2048
+
+/// Renders audio on a dedicated engine thread, some frames ahead of the
+/// device, into a lock-free ring. The audio callback then only copies, so a
+/// single slow block is absorbed by the ring instead of causing a dropout.
+///
+/// Only one side renders at any time: the engine thread while active, the
+/// caller (direct rendering) while bypassed. The switch is always made by the
+/// audio thread, between callbacks, so the render function never runs twice
+/// at once.
+class RenderAhead {
+public:
+	/// Fills the buffer with the given number of frames.
+	using RenderFn = std::function<void(float*, u32)>;
+
+	~RenderAhead();
+
+	/// Starts the engine thread. aheadFrames is rounded up to a whole number of blocks.
+	/// Reallocates the ring: read() must not run meanwhile (pause the callback).
+	void start(const RenderFn& render, u32 aheadFrames = TWEN_RENDER_AHEAD_FRAMES);
+
+	/// Waits for the current block and stops the engine thread.
+	void stop();
+
+	bool running() const { return m_running.load(); }
+
+	/// True while the audio thread renders directly (e.g. for live input).
+	bool bypassed() const { return m_bypass.load(); }
+
+	/// Audio thread. Copies frames from the ring. Returns false when the
+	/// caller has to render them itself (stopped or bypassed).
+	bool read(float* out, u32 frames);
+
+	/// Audio thread. Switches to direct rendering, dropping what was rendered ahead.
+	void bypass();
+
+	/// Any thread. Asks the audio thread to hand rendering back to the engine thread.
+	void resume() { m_resume = true; }
+
+	/// Callbacks that found the ring short of frames.
+	u64 underruns() const { return m_underruns.load(); }
+
+private:
+	RenderFn m_render;
+	u32 m_ahead{ TWEN_RENDER_AHEAD_FRAMES };
+
+	Vec<float> m_ring;
+	std::atomic<u64> m_read{ 0 }, m_write{ 0 };
+
+	std::thread m_thread;
+	std::atomic<bool> m_active{ false }, m_running{ false };
+	std::atomic<bool> m_bypass{ false }, m_resume{ false }, m_engineIdle{ true };
+	bool m_flushed{ false };
+	std::atomic<u64> m_underruns{ 0 };
+
+	void run();
+};
+
+#endif // TWEN_RENDER_AHEAD_H
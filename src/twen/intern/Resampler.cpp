@@ -0,0 +1,147 @@
+#include "Resampler.h"
+
+#include <algorithm>
+
+#if defined(USING_SSE2) || defined(USING_SSE3) || defined(USING_SSE2_MSVC)
+#include <xmmintrin.h>
+#define RESAMPLER_SIMD
+#endif
+
+static float blackman(float x) {
+	// x in [0, 1]
+	return 0.42f - 0.5f * std::cos(PI2 * x) + 0.08f * std::cos(2.0f * PI2 * x);
+}
+
+SincKernel::SincKernel(float cutoff, u32 taps)
+	: m_taps(taps)
+{
+	const u32 half = taps / 2;
+	Vec<float> table((TWEN_RESAMPLER_PHASES + 1) * taps);
+	for (u32 p = 0; p <= TWEN_RESAMPLER_PHASES; p++) {
+		const float frac = float(p) / TWEN_RESAMPLER_PHASES;
+		float sum = 0.0f;
+		for (u32 t = 0; t < taps; t++) {
+			// Distance from the output position to tap t
+			float x = float(t) - float(half - 1) - frac;
+			float s = x == 0.0f ? 1.0f : std::sin(PI * cutoff * x) / (PI * cutoff * x);
+			float w = blackman((x + float(half)) / float(taps));
+			table[p * taps + t] = s * w;
+			sum += s * w;
+		}
+		// Unity gain at DC for every phase
+		for (u32 t = 0; t < taps; t++) {
+			table[p * taps + t] /= sum;
+		}
+	}
+
+	m_coeffs.resize(TWEN_RESAMPLER_PHASES * taps);
+	m_deltas.resize(TWEN_RESAMPLER_PHASES * taps);
+	for (u32 p = 0; p < TWEN_RESAMPLER_PHASES; p++) {
+		for (u32 t = 0; t < taps; t++) {
+			m_coeffs[p * taps + t] = table[p * taps + t];
+			m_deltas[p * taps + t] = table[(p + 1) * taps + t] - table[p * taps + t];
+		}
+	}
+}
+
+float SincKernel::apply(const float* window, float frac) const {
+	const float fp = frac * TWEN_RESAMPLER_PHASES;
+	const u32 phase = std::min(u32(fp), u32(TWEN_RESAMPLER_PHASES - 1));
+	const float t = fp - float(phase);
+
+	const float* c = &m_coeffs[phase * m_taps];
+	const float* d = &m_deltas[phase * m_taps];
+
+#ifdef RESAMPLER_SIMD
+	__m128 acc = _mm_setzero_ps();
+	const __m128 vt = _mm_set1_ps(t);
+	for (u32 i = 0; i < m_taps; i += 4) {
+		__m128 k = _mm_add_ps(_mm_loadu_ps(c + i), _mm_mul_ps(_mm_loadu_ps(d + i), vt));
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(window + i), k));
+	}
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, acc);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+	float acc = 0.0f;
+	for (u32 i = 0; i < m_taps; i++) {
+		acc += window[i] * (c[i] + d[i] * t);
+	}
+	return acc;
+#endif
+}
+
+namespace Resampler {
+
+	const SincKernel& kernel(float step) {
+		// Octave k covers steps up to 2^k: cutoff 1/2^k, widened to keep the same quality
+		static const Vec<SincKernel> kernels = []() {
+			Vec<SincKernel> ks;
+			for (u32 k = 0; k < TWEN_RESAMPLER_OCTAVES; k++) {
+				ks.emplace_back(0.95f / float(1 << k), TWEN_RESAMPLER_TAPS << k);
+			}
+			return ks;
+		}();
+
+		u32 k = 0;
+		while (k < TWEN_RESAMPLER_OCTAVES - 1 && step > float(1 << k)) k++;
+		return kernels[k];
+	}
+
+	float interpolate(const float* data, u64 length, double pos, float step) {
+		const SincKernel& k = kernel(step);
+		const i64 half = k.taps() / 2;
+		const i64 base = i64(pos);
+		const i64 first = base - half + 1;
+		const float frac = float(pos - double(base));
+
+		if (first >= 0 && u64(first + k.taps()) <= length) {
+			return k.apply(data + first, frac);
+		}
+
+		// Near the edges, pad with silence
+		alignas(16) float window[TWEN_RESAMPLER_TAPS << (TWEN_RESAMPLER_OCTAVES - 1)];
+		for (i64 i = 0; i < i64(k.taps()); i++) {
+			i64 f = first + i;
+			window[i] = (f < 0 || u64(f) >= length) ? 0.0f : data[f];
+		}
+		return k.apply(window, frac);
+	}
+
+	Vec<float> convert(const Vec<float>& in, float fromRate, float toRate) {
+		if (in.empty() || fromRate <= 0.0f || toRate <= 0.0f || fromRate == toRate) {
+			return in;
+		}
+
+		const double step = double(fromRate) / double(toRate);
+		const u64 length = u64(std::ceil(double(in.size()) / step));
+
+		// Downsampling needs the cutoff at the output Nyquist frequency
+		const float cutoff = 0.95f * float(std::min(1.0, 1.0 / step));
+		u32 taps = u32(std::ceil(TWEN_RESAMPLER_TAPS / cutoff * 0.95f));
+		taps = (taps + 3) & ~3u;
+		const SincKernel k(cutoff, taps);
+
+		const i64 half = taps / 2;
+		Vec<float> window(taps + 4);
+		Vec<float> out(length);
+		for (u64 i = 0; i < length; i++) {
+			const double pos = double(i) * step;
+			const i64 base = i64(pos);
+			const i64 first = base - half + 1;
+			const float frac = float(pos - double(base));
+
+			if (first >= 0 && u64(first + taps) <= in.size()) {
+				out[i] = k.apply(in.data() + first, frac);
+			} else {
+				for (i64 t = 0; t < i64(taps); t++) {
+					i64 f = first + t;
+					window[t] = (f < 0 || u64(f) >= in.size()) ? 0.0f : in[f];
+				}
+				out[i] = k.apply(window.data(), frac);
+			}
+		}
+		return out;
+	}
+
+}
@@ -0,0 +1,59 @@
+#ifndef TWEN_RESAMPLER_H
+#define TWEN_RESAMPLER_H
+
+#include "Utils.h"
+
+// Kernel width in input samples at unity cutoff (must be a multiple of 4)
+#define TWEN_RESAMPLER_TAPS 16
+// Sub-sample positions stored in the polyphase table
+#define TWEN_RESAMPLER_PHASES 256
+// Lowered-cutoff kernels for reading faster than the source rate (2x, 4x, 8x)
+#define TWEN_RESAMPLER_OCTAVES 4
+
+/// Polyphase Blackman-windowed sinc kernel. The table holds one row of taps
+/// per phase plus the delta to the next row, so fractional positions are
+/// interpolated linearly between phases.
+class SincKernel {
+public:
+	/// cutoff is relative to the input Nyquist frequency (0, 1].
+	SincKernel(float cutoff, u32 taps = TWEN_RESAMPLER_TAPS);
+
+	u32 taps() const { return m_taps; }
+
+	/// Convolves taps() samples starting at window with the kernel at frac.
+	/// The output position lies between window[taps()/2 - 1] and window[taps()/2].
+	float apply(const float* window, float frac) const;
+
+private:
+	u32 m_taps;
+	Vec<float> m_coeffs, m_deltas;
+};
+
+namespace Resampler {
+	/// The shared kernel for reading with the given step (input frames per output frame).
+	const SincKernel& kernel(float step);
+
+	/// Band-limited read at a fractional position of a buffer. Out of range taps read as 0.
+	float interpolate(const float* data, u64 length, double pos, float step = 1.0f);
+
+	/// Same as above, but fetches the taps through at(frame), for sources
+	/// that are not a single contiguous buffer.
+	template <typename Fn>
+	float interpolate(Fn&& at, double pos, float step = 1.0f) {
+		const SincKernel& k = kernel(step);
+		const i64 half = k.taps() / 2;
+		const i64 base = i64(pos);
+
+		alignas(16) float window[TWEN_RESAMPLER_TAPS << (TWEN_RESAMPLER_OCTAVES - 1)];
+		for (i64 i = 0; i < i64(k.taps()); i++) {
+			i64 f = base - half + 1 + i;
+			window[i] = f < 0 ? 0.0f : at(u64(f));
+		}
+		return k.apply(window, float(pos - double(base)));
+	}
+
+	/// Converts a whole buffer from one sample rate to another.
+	Vec<float> convert(const Vec<float>& in, float fromRate, float toRate);
+}
+
+#endif // TWEN_RESAMPLER_H
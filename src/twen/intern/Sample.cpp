@@ -1,42 +1,108 @@
 #include "Sample.h"
 
 #include "Log.h"
+#include "Resampler.h"
 #include "TAudio.h"
 
-Sample::Sample(const std::string& fileName) {
+Sample::Sample(SampleBuffer head, float sr, const Str& fileName, u64 length)
+	: m_sampleData(head), m_frame(0), m_sampleRate(sr), m_state(Idle), m_length(length)
+{
+	u64 headSize = head ? head->size() : 0;
+	if (length > headSize) {
+		m_stream = SampleStream::open(fileName, headSize);
+	} else {
+		m_length = headSize;
+	}
+}
+
+Sample::Sample(const std::string& fileName)
+	: m_frame(0), m_sampleRate(0.0f), m_state(Idle), m_length(0)
+{
 	TAudioFile snd(fileName);
-	int maxSecs = 15;
-	if (snd.sampleRate() > 44100) {
-		maxSecs = 10;
+	if (snd.channels() == 0) return;
+
+	m_sampleRate = snd.sampleRate();
+
+	const bool stream = shouldStream(snd.frames(), snd.sampleRate());
+
+	Vec<float> data;
+	if (stream) {
+		data.resize(u64(snd.sampleRate()) * TWEN_SAMPLE_STREAM_HEAD_SECONDS);
+	} else {
+		data.resize(snd.frames());
+	}
+	data.resize(readMono(snd, data.data(), data.size()));
+
+	m_length = stream ? snd.frames() : data.size();
+	if (stream) {
+		m_stream = SampleStream::open(fileName, data.size());
 	}
-	if (snd.frames() < snd.sampleRate() * maxSecs) {
-		m_sampleRate = snd.sampleRate();
+	m_sampleData = std::make_shared<const Vec<float>>(std::move(data));
+}
+
+const Vec<float>& Sample::sampleData() const {
+	static const Vec<float> empty;
+	return m_sampleData ? *m_sampleData : empty;
+}
 
-		std::vector<float> samplesRaw;
-		samplesRaw.resize(snd.frames() * snd.channels());
-		u32 interleavedFrames = snd.readf(samplesRaw.data(), samplesRaw.size());
+u64 Sample::readMono(TAudioFile& file, float* out, u64 frames) {
+	const u32 channels = file.channels();
+	if (channels == 0) return 0;
+	if (channels == 1) return file.readf(out, frames);
 
-		m_sampleData.resize(interleavedFrames / snd.channels());
-		std::fill(m_sampleData.begin(), m_sampleData.end(), 0.0f);
+	const u64 chunk = 1024;
+	Vec<float> interleaved(chunk * channels);
 
-		u32 s = 0;
-		for (int i = 0; i < interleavedFrames; i+=snd.channels()) {
-			for (int c = 0; c < snd.channels(); c++) {
-				m_sampleData[s] = samplesRaw[c + i * snd.channels()];
+	u64 total = 0;
+	while (total < frames) {
+		u64 n = file.readf(interleaved.data(), std::min(chunk, frames - total));
+		for (u64 i = 0; i < n; i++) {
+			float sum = 0.0f;
+			for (u32 c = 0; c < channels; c++) {
+				sum += interleaved[i * channels + c];
 			}
-			m_sampleData[s] /= snd.channels();
-			s++;
+			out[total + i] = sum / channels;
 		}
-		m_frame = 0;
+		total += n;
+		if (n < chunk) break;
+	}
+	return total;
+}
+
+bool Sample::shouldStream(u64 frames, u32 sampleRate) {
+	u64 maxSecs = sampleRate > 44100 ? TWEN_SAMPLE_MAX_SECONDS_HIGH_SR : TWEN_SAMPLE_MAX_SECONDS;
+	return frames >= u64(sampleRate) * maxSecs;
+}
+
+float Sample::at(u64 frame) {
+	if (m_sampleData && frame < m_sampleData->size()) return (*m_sampleData)[frame];
+	return m_stream ? m_stream->read(frame) : 0.0f;
+}
+
+float Sample::read(float sampleRate) {
+	if (m_sampleRate == sampleRate) {
+		return at(u64(m_frame));
+	}
+
+	const float step = m_sampleRate / sampleRate;
+	if (m_stream) {
+		return Resampler::interpolate([this](u64 f) { return at(f); }, m_frame, step);
 	}
+	return Resampler::interpolate(m_sampleData->data(), m_sampleData->size(), m_frame, step);
+}
+
+void Sample::rewind() {
+	m_frame = 0;
+	if (m_stream) m_stream->restart();
 }
 
 float Sample::sampleDirect(float sampleRate) {
-	float out = m_sampleData[int(m_frame)];
+	if (!valid()) return 0.0f;
+	float out = read(sampleRate);
 	float frameStep = m_sampleRate / sampleRate;
 
-	if (m_frame >= m_sampleData.size()) {
-		m_frame = 0.0f;
+	if (m_frame >= m_length) {
+		rewind();
 	} else {
 		m_frame += frameStep;
 	}
@@ -59,18 +125,18 @@ float Sample::sample(float sampleRate, bool repeat) {
 	switch (m_state) {
 		case Idle: break;
 		case Attack: {
-			if (m_frame < m_sampleData.size()) {
-				out = m_sampleData[u32(m_frame)];
+			if (m_frame < m_length) {
+				out = read(sampleRate);
 			}
 
 			m_frame += frameStep;
-			if (m_frame >= m_sampleData.size()) {
+			if (m_frame >= m_length) {
 				if (!repeat) m_state = Decay;
-				else m_frame = 0;
+				else rewind();
 			}
 		} break;
 		case Decay: {
-			m_frame = 0;
+			rewind();
 			m_state = Idle;
 		} break;
 		default: break;
@@ -2,7 +2,22 @@
 #define TWEN_SAMPLE_H
 
 #include "Utils.h"
+#include "State.h"
+#include "SampleStream.h"
 
+// Samples longer than this are streamed from disk instead of decoded into RAM
+#define TWEN_SAMPLE_MAX_SECONDS 15
+#define TWEN_SAMPLE_MAX_SECONDS_HIGH_SR 10
+
+// How much of a streamed sample is kept in memory to start playback instantly
+#define TWEN_SAMPLE_STREAM_HEAD_SECONDS 2
+
+/// Immutable sample data, shared between the sample library and every
+/// Sample playing it. Removing a sample from the library never frees data
+/// that is still being played.
+using SampleBuffer = std::shared_ptr<const Vec<float>>;
+
+class TAudioFile;
 class Sample {
 public:
 	enum State {
@@ -11,32 +26,57 @@ public:
 		Decay
 	};
 
-	Sample() : m_frame(0), m_sampleRate(0.0f), m_state(Idle) { }
-	Sample(const Vec<float> data, float sr)
-		: m_sampleData(data), m_sampleRate(sr), m_frame(0), m_state(Idle)
+	Sample() : m_frame(0), m_sampleRate(0.0f), m_state(Idle), m_length(0) { }
+	Sample(SampleBuffer data, float sr)
+		: m_sampleData(data), m_frame(0), m_sampleRate(sr), m_state(Idle),
+		  m_length(data ? data->size() : 0)
 	{ }
+	/// Streamed sample: data is the in-memory head, the rest comes from fileName.
+	Sample(SampleBuffer head, float sr, const Str& fileName, u64 length);
 	Sample(const Str& fileName);
 
-	bool valid() const { return !m_sampleData.empty() && m_sampleRate > 0.0f; }
-	void invalidate() { m_sampleData.clear(); }
+	bool valid() const { return m_sampleData && !m_sampleData->empty() && m_sampleRate > 0.0f; }
+	void invalidate() { m_sampleData.reset(); m_stream.reset(); m_length = 0; }
 
-	Vec<float> sampleData() const { return m_sampleData; }
+	/// In-memory data (the head, for streamed samples). Empty if invalid.
+	const Vec<float>& sampleData() const;
 	float sampleRate() const { return m_sampleRate; }
-	float frame() const { return m_frame; }
+	float frame() const { return float(m_frame); }
+	u64 length() const { return m_length; }
+	bool streamed() const { return m_stream != nullptr; }
 
 	float sampleDirect(float sampleRate);
 
 	void gate(bool g);
 	float sample(float sampleRate, bool repeat = false);
-	void reset() { m_frame = 0; m_state = Idle; }
+	void reset() { rewind(); m_state = Idle; }
 
 	State state() const { return m_state; }
 
+	/// The playhead. A streamed sample restored past its head stays silent
+	/// until it's rewound, since the disk stream only reads forward.
+	void saveState(StateWriter& w) const { w << m_frame << m_state; }
+	void restoreState(StateReader& r) { r >> m_frame >> m_state; }
+
+	/// Reads up to frames frames from file, mixing all channels down to mono.
+	static u64 readMono(TAudioFile& file, float* out, u64 frames);
+
+	/// Whether a file of this length should be streamed rather than loaded.
+	static bool shouldStream(u64 frames, u32 sampleRate);
+
 protected:
-	Vec<float> m_sampleData;
-	float m_frame;
+	SampleBuffer m_sampleData;
+	double m_frame;
 	float m_sampleRate;
 	State m_state;
+
+	std::shared_ptr<SampleStream> m_stream;
+	u64 m_length;
+
+	float at(u64 frame);
+	/// Reads at the playhead, interpolating unless the rates match.
+	float read(float sampleRate);
+	void rewind();
 };
 
 #endif // TWEN_SAMPLE_H
@@ -0,0 +1,135 @@
+#include "SampleStream.h"
+
+#include "Log.h"
+#include "Sample.h"
+#include "TAudio.h"
+
+#include <algorithm>
+#include <chrono>
+
+std::shared_ptr<SampleStream> SampleStream::open(const Str& fileName, u64 offset) {
+	auto stream = std::make_shared<SampleStream>(fileName, offset);
+	SampleStreamer::add(stream);
+	return stream;
+}
+
+SampleStream::SampleStream(const Str& fileName, u64 offset)
+	: m_fileName(fileName), m_offset(offset)
+{
+	m_ring.resize(TWEN_STREAM_RING_SIZE, 0.0f);
+}
+
+SampleStream::~SampleStream() = default;
+
+float SampleStream::read(u64 frame) {
+	if (m_requested.load(std::memory_order_relaxed) != m_served.load(std::memory_order_acquire))
+		return 0.0f;
+	if (frame < m_offset)
+		return 0.0f;
+
+	u64 pos = frame - m_offset;
+	if (pos >= m_write.load(std::memory_order_acquire) || pos < m_read.load(std::memory_order_relaxed))
+		return 0.0f;
+
+	float v = m_ring[pos % TWEN_STREAM_RING_SIZE];
+
+	// Everything before pos (minus the interpolation history) can be overwritten now
+	u64 keep = pos > TWEN_STREAM_HISTORY ? pos - TWEN_STREAM_HISTORY : 0;
+	if (keep > m_read.load(std::memory_order_relaxed)) {
+		m_read.store(keep, std::memory_order_release);
+	}
+	return v;
+}
+
+void SampleStream::restart() {
+	m_requested.fetch_add(1, std::memory_order_release);
+}
+
+bool SampleStream::fill() {
+	u32 req = m_requested.load(std::memory_order_acquire);
+	bool rewind = req != m_served.load(std::memory_order_relaxed);
+
+	if (!m_file) {
+		m_file = Ptr<TAudioFile>(new TAudioFile(m_fileName));
+		if (m_file->channels() == 0) {
+			LogE("Could not stream: ", m_fileName);
+			m_eof = true;
+			return false;
+		}
+		rewind = true;
+	}
+
+	if (rewind) {
+		// The audio thread does not touch the ring until we acknowledge
+		m_file->seek(m_offset);
+		m_read.store(0, std::memory_order_relaxed);
+		m_write.store(0, std::memory_order_relaxed);
+		m_eof = false;
+		m_served.store(req, std::memory_order_release);
+	}
+
+	if (m_eof) return false;
+
+	u64 w = m_write.load(std::memory_order_relaxed);
+	u64 r = m_read.load(std::memory_order_acquire);
+	if (TWEN_STREAM_RING_SIZE - (w - r) < TWEN_STREAM_CHUNK_SIZE)
+		return false;
+
+	m_scratch.resize(TWEN_STREAM_CHUNK_SIZE);
+	u64 n = Sample::readMono(*m_file, m_scratch.data(), TWEN_STREAM_CHUNK_SIZE);
+	for (u64 i = 0; i < n; i++) {
+		m_ring[(w + i) % TWEN_STREAM_RING_SIZE] = m_scratch[i];
+	}
+	m_write.store(w + n, std::memory_order_release);
+
+	if (n < TWEN_STREAM_CHUNK_SIZE) m_eof = true;
+	return n > 0;
+}
+
+SampleStreamer::SampleStreamer() {
+	m_thread = std::thread(&SampleStreamer::run, this);
+}
+
+SampleStreamer::~SampleStreamer() {
+	m_running = false;
+	if (m_thread.joinable()) m_thread.join();
+}
+
+SampleStreamer& SampleStreamer::get() {
+	static SampleStreamer streamer;
+	return streamer;
+}
+
+void SampleStreamer::add(const std::shared_ptr<SampleStream>& stream) {
+	SampleStreamer& s = get();
+	std::lock_guard<std::mutex> lk(s.m_lock);
+	s.m_streams.push_back(stream);
+}
+
+void SampleStreamer::run() {
+	Vec<std::shared_ptr<SampleStream>> live;
+	while (m_running) {
+		{
+			std::lock_guard<std::mutex> lk(m_lock);
+			auto end = std::remove_if(
+				m_streams.begin(), m_streams.end(),
+				[](const std::weak_ptr<SampleStream>& s) { return s.expired(); }
+			);
+			m_streams.erase(end, m_streams.end());
+
+			for (auto&& s : m_streams) {
+				if (auto ptr = s.lock()) live.push_back(ptr);
+			}
+		}
+
+		bool busy = false;
+		for (auto&& s : live) {
+			busy |= s->fill();
+		}
+		live.clear();
+
+		if (!busy) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef TWEN_SAMPLE_STREAM_H
+#define TWEN_SAMPLE_STREAM_H
+
+#include "Utils.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#define TWEN_STREAM_RING_SIZE 65536
+#define TWEN_STREAM_CHUNK_SIZE 4096
+// Frames behind the read position kept for the resampler's kernel taps
+#define TWEN_STREAM_HISTORY 256
+
+class TAudioFile;
+
+/// Per-voice disk stream for the part of a sample that lives past the head
+/// kept in memory. The background streamer decodes the file into a ring
+/// buffer (producer) and the audio thread consumes it with read().
+class SampleStream {
+	friend class SampleStreamer;
+public:
+	/// Creates a stream starting at frame offset and hands it to the streamer.
+	static std::shared_ptr<SampleStream> open(const Str& fileName, u64 offset);
+
+	SampleStream(const Str& fileName, u64 offset);
+	~SampleStream();
+
+	/// Audio thread. Returns 0 on underrun or while a restart is pending.
+	float read(u64 frame);
+
+	/// Audio thread. Asks the streamer to rewind to the offset and refill.
+	void restart();
+
+	u64 offset() const { return m_offset; }
+
+private:
+	Str m_fileName;
+	u64 m_offset;
+
+	Ptr<TAudioFile> m_file;
+	Vec<float> m_ring, m_scratch;
+	bool m_eof{ false };
+
+	std::atomic<u64> m_read{ 0 }, m_write{ 0 };
+	std::atomic<u32> m_requested{ 0 }, m_served{ 0 };
+
+	bool fill();
+};
+
+/// Background I/O thread that keeps every live SampleStream topped up.
+class SampleStreamer {
+public:
+	static void add(const std::shared_ptr<SampleStream>& stream);
+
+	~SampleStreamer();
+
+private:
+	SampleStreamer();
+	static SampleStreamer& get();
+
+	Vec<std::weak_ptr<SampleStream>> m_streams;
+	std::mutex m_lock;
+	std::thread m_thread;
+	std::atomic<bool> m_running{ true };
+
+	void run();
+};
+
+#endif // TWEN_SAMPLE_STREAM_H
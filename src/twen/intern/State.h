@@ -0,0 +1,78 @@
+#ifndef TWEN_STATE_H
+#define TWEN_STATE_H
+
+#include "Utils.h"
+
+#include <cstring>
+#include <type_traits>
+
+/// Raw binary image of DSP state (see Node::saveState). Only meant to be
+/// read back by the same build, so values are written as they are in memory.
+using StateData = Vec<u8>;
+
+class StateWriter {
+public:
+	StateWriter(StateData& out) : m_out(out) {}
+
+	template<typename T>
+	StateWriter& operator <<(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written.");
+		write(&value, sizeof(T));
+		return *this;
+	}
+
+	void write(const void* data, size_t size) {
+		const u8* bytes = static_cast<const u8*>(data);
+		m_out.insert(m_out.end(), bytes, bytes + size);
+	}
+
+	size_t size() const { return m_out.size(); }
+
+private:
+	StateData& m_out;
+};
+
+class StateReader {
+public:
+	StateReader(const u8* data, size_t size) : m_data(data), m_size(size) {}
+	StateReader(const StateData& data) : m_data(data.data()), m_size(data.size()) {}
+
+	/// Reading past the end gives zeros and clears ok().
+	template<typename T>
+	StateReader& operator >>(T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read.");
+		read(&value, sizeof(T));
+		return *this;
+	}
+
+	void read(void* data, size_t size) {
+		if (m_pos + size > m_size) {
+			std::memset(data, 0, size);
+			m_pos = m_size;
+			m_ok = false;
+			return;
+		}
+		std::memcpy(data, m_data + m_pos, size);
+		m_pos += size;
+	}
+
+	void skip(size_t size) {
+		if (m_pos + size > m_size) {
+			m_pos = m_size;
+			m_ok = false;
+			return;
+		}
+		m_pos += size;
+	}
+
+	bool ok() const { return m_ok; }
+	size_t position() const { return m_pos; }
+	bool atEnd() const { return m_pos == m_size; }
+
+private:
+	const u8* m_data;
+	size_t m_size, m_pos{ 0 };
+	bool m_ok{ true };
+};
+
+#endif // TWEN_STATE_H
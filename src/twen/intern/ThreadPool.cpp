@@ -0,0 +1,57 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(u32 threads) {
+	if (threads == 0) {
+		u32 cores = std::thread::hardware_concurrency();
+		threads = cores > 1 ? cores - 1 : 1;
+	}
+	for (u32 i = 0; i < threads; i++) {
+		m_workers.emplace_back(&ThreadPool::worker, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lk(m_lock);
+		m_stop = true;
+	}
+	m_taskReady.notify_all();
+	for (auto&& th : m_workers) {
+		if (th.joinable()) th.join();
+	}
+}
+
+void ThreadPool::submit(const Task& task) {
+	{
+		std::lock_guard<std::mutex> lk(m_lock);
+		m_tasks.push_back(task);
+		m_pending++;
+	}
+	m_taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lk(m_lock);
+	m_idle.wait(lk, [this]() { return m_pending.load() == 0; });
+}
+
+void ThreadPool::worker() {
+	while (true) {
+		Task task;
+		{
+			std::unique_lock<std::mutex> lk(m_lock);
+			m_taskReady.wait(lk, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty()) return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lk(m_lock);
+			m_pending--;
+		}
+		m_idle.notify_all();
+	}
+}
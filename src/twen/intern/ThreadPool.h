@@ -0,0 +1,42 @@
+#ifndef TWEN_THREAD_POOL_H
+#define TWEN_THREAD_POOL_H
+
+#include "Utils.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using Task = std::function<void()>;
+
+class ThreadPool {
+public:
+	/// Creates the workers. 0 threads means one per core (minus the caller's).
+	ThreadPool(u32 threads = 0);
+	~ThreadPool();
+
+	void submit(const Task& task);
+
+	/// Blocks until every submitted task has finished.
+	void wait();
+
+	u32 size() const { return u32(m_workers.size()); }
+	u32 pending() const { return m_pending.load(); }
+
+private:
+	Vec<std::thread> m_workers;
+	std::deque<Task> m_tasks;
+
+	std::mutex m_lock;
+	std::condition_variable m_taskReady, m_idle;
+
+	std::atomic<u32> m_pending{ 0 };
+	bool m_stop{ false };
+
+	void worker();
+};
+
+#endif // TWEN_THREAD_POOL_H
@@ -2,6 +2,7 @@
 #define TWEN_WAVE_GUIDE_H
 
 #include "Utils.h"
+#include "State.h"
 
 #define WAVE_GUIDE_SAMPLES 22050
 class WaveGuide {
@@ -14,6 +15,9 @@ public:
 
 	void sampleRate(float sr) { m_sampleRate = sr; }
 
+	void saveState(StateWriter& w) const { w << m_counter << m_buffer; }
+	void restoreState(StateReader& r) { r >> m_counter >> m_buffer; }
+
 private:
 	float m_sampleRate;
 	Arr<float, WAVE_GUIDE_SAMPLES> m_buffer;
@@ -2,6 +2,7 @@
 #define TWEN_ADSR_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 #include "../intern/ADSR.h"
 
 class ADSRNode : public Node {
@@ -38,6 +39,28 @@ public:
 		return Value(m_adsr.sample());
 	}
 
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("a", a);
+		ex.param("d", d);
+		ex.param("s", s);
+		ex.param("r", r);
+		return true;
+	}
+
+	inline bool settled() const override {
+		return m_adsr.state() == ADSR::Idle && !m_trigger;
+	}
+
+	inline void saveState(StateWriter& w) const override {
+		m_adsr.saveState(w);
+		w << m_trigger;
+	}
+
+	inline void restoreState(StateReader& r) override {
+		m_adsr.restoreState(r);
+		r >> m_trigger;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["a"] = a;
@@ -46,16 +69,20 @@ public:
 		json["r"] = r;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		a = json["a"];
-		d = json["d"];
-		s = json["s"];
-		r = json["r"];
+		a = json.value("a", a);
+		d = json.value("d", d);
+		s = json.value("s", s);
+		r = json.value("r", r);
 	}
 
 	inline ADSR& adsr() { return m_adsr; }
 
+	inline void reset() override {
+		m_adsr.reset();
+	}
+
 	float a, d, s, r;
 
 private:
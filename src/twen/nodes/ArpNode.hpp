@@ -4,6 +4,7 @@
 #include <iostream>
 #include <cmath>
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class ArpNode : public Node {
 	TWEN_NODE(ArpNode, "Arp")
@@ -31,7 +32,7 @@ public:
 		DirectionCount
 	};
 
-	inline ArpNode(Note note, Chord chord, Direction dir, u32 oct)
+	inline ArpNode(Note note=Note::C, Chord chord=Major, Direction dir=Up, u32 oct=0)
 		: Node(), note(note), chord(chord), direction(dir), oct(oct)
 	{
 		addInput("Base");
@@ -129,6 +130,26 @@ public:
 		return Value(outNote, 1.0f, gate && baseGate);
 	}
 
+	inline bool deterministic() const override {
+		return direction != Random;
+	}
+
+	inline void saveState(StateWriter& w) const override {
+		w << gate << prevNt << prevRN << prevN << randN;
+	}
+
+	inline void restoreState(StateReader& r) override {
+		r >> gate >> prevNt >> prevRN >> prevN >> randN;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("note", int(note), "Note");
+		ex.param("chord", int(chord), "ArpNode::Chord");
+		ex.param("direction", int(direction), "ArpNode::Direction");
+		ex.param("oct", oct);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["note"] = int(note);
@@ -137,12 +158,12 @@ public:
 		json["oct"] = oct;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		note = Note(json["note"].get<int>());
-		chord = Chord(json["chord"].get<int>());
-		direction = Direction(json["direction"].get<int>());
-		oct = json["oct"].get<u32>();
+		note = Note(json.value("note", int(note)));
+		chord = Chord(json.value("chord", int(chord)));
+		direction = Direction(json.value("direction", int(direction)));
+		oct = json.value("oct", oct);
 	}
 
 	Note note;
@@ -2,6 +2,7 @@
 #define TWEN_CHORUS_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 #include "../intern/Oscillator.h"
 #include "../intern/WaveGuide.h"
 
@@ -32,6 +33,23 @@ public:
 		return Value(((_out + in(0).value()) * 0.5f));
 	}
 
+	inline void saveState(StateWriter& w) const override {
+		m_lfo.saveState(w);
+		m_wv.saveState(w);
+	}
+
+	inline void restoreState(StateReader& r) override {
+		m_lfo.restoreState(r);
+		m_wv.restoreState(r);
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("rate", rate);
+		ex.param("depth", depth);
+		ex.param("delay", delay);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["rate"] = rate;
@@ -39,11 +57,11 @@ public:
 		json["delay"] = delay;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		rate = json["rate"];
-		depth = json["depth"];
-		delay = json["delay"];
+		rate = json.value("rate", rate);
+		depth = json.value("depth", depth);
+		delay = json.value("delay", delay);
 	}
 
 	float rate, depth, delay;
@@ -2,6 +2,7 @@
 #define TWEN_DELAY_LINE_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 #include "../intern/WaveGuide.h"
 
 class DelayLineNode : public Node {
@@ -15,7 +16,36 @@ public:
 
 	inline Value sample(NodeGraph *graph) override {
 		m_wv.sampleRate(graph->sampleRate());
-		return Value(m_wv.sample(in(0).value(), feedBack, delay));
+		float out = m_wv.sample(in(0).value(), feedBack, delay);
+
+		// Once input and output have been silent for the whole line, so is
+		// everything still in it
+		if (std::abs(in(0).value()) < TWEN_SILENCE && std::abs(out) < TWEN_SILENCE) {
+			m_quiet = std::min(m_quiet + 1, u32(WAVE_GUIDE_SAMPLES));
+		} else {
+			m_quiet = 0;
+		}
+		return Value(out);
+	}
+
+	inline bool settled() const override {
+		return m_quiet >= WAVE_GUIDE_SAMPLES;
+	}
+
+	inline void saveState(StateWriter& w) const override {
+		m_wv.saveState(w);
+		w << m_quiet;
+	}
+
+	inline void restoreState(StateReader& r) override {
+		m_wv.restoreState(r);
+		r >> m_quiet;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("feedBack", feedBack);
+		ex.param("delay", delay);
+		return true;
 	}
 
 	inline void save(JSON& json) override {
@@ -24,16 +54,17 @@ public:
 		json["delay"] = delay;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		feedBack = json["feedBack"];
-		delay = json["delay"];
+		feedBack = json.value("feedBack", feedBack);
+		delay = json.value("delay", delay);
 	}
 
 	float feedBack, delay;
 
 private:
 	WaveGuide m_wv;
+	u32 m_quiet{ 0 };
 
 };
 
@@ -2,6 +2,7 @@
 #define TWEN_FILTER_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class FilterNode : public Node {
 	TWEN_NODE(FilterNode, "Filter")
@@ -46,23 +47,36 @@ public:
 		return Value(_out);
 	}
 
+	inline bool settled() const override {
+		return std::abs(m_inputs[0].data.value) < TWEN_SILENCE && std::abs(_out) < TWEN_SILENCE && std::abs(prev) < TWEN_SILENCE;
+	}
+
+	inline void saveState(StateWriter& w) const override { w << _out << prev; }
+	inline void restoreState(StateReader& r) override { r >> _out >> prev; }
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("cutOff", cutOff);
+		ex.param("filter", int(filter), "FilterNode::Filter");
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["cutOff"] = cutOff;
 		json["filter"] = int(filter);
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		cutOff = json["cutOff"];
-		filter = Filter(json["filter"].get<int>());
+		cutOff = json.value("cutOff", cutOff);
+		filter = Filter(json.value("filter", int(filter)));
 	}
 
 	float cutOff;
 	Filter filter;
 
 private:
-	float _out, prev;
+	float _out{ 0.0f }, prev{ 0.0f };
 };
 
 #endif // TWEN_FILTER_NODE_H
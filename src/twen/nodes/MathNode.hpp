@@ -2,11 +2,13 @@
 #define TWEN_MATH_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class MathNode : public Node {
 	TWEN_NODE(MathNode, "Math")
 public:
-	enum MathOp {
+	// int sized, the editor's combo box edits it as an int
+	enum MathOp : int {
 		Add = 0,
 		Sub,
 		Mul,
@@ -15,7 +17,7 @@ public:
 		OpCount
 	};
 
-	inline MathNode(MathOp op, float a=0, float b=0)
+	inline MathNode(MathOp op=Add, float a=0, float b=0)
 		: Node(), op(op), a(a), b(b)
 	{
 		addInput("A"); // A
@@ -38,17 +40,35 @@ public:
 		return Value(_out);
 	}
 
+	inline bool fuse(KernelBuilder& kb) override {
+		u16 _a = connected(0) ? kb.input(0) : kb.param(&a);
+		u16 _b = connected(1) ? kb.input(1) : kb.param(&b);
+		// Reads op every sample, changing it needs no recompile
+		kb.output(kb.math(&op, _a, _b));
+		return true;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("op", int(op), "MathNode::MathOp");
+		ex.param("a", a);
+		ex.param("b", b);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["op"] = int(op);
 		json["values"] = { a, b };
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		op = MathOp(json["op"].get<int>());
-		a = json["values"][0];
-		b = json["values"][1];
+		op = MathOp(json.value("op", int(op)));
+		auto values = json.find("values");
+		if (values != json.end() && values->is_array() && values->size() >= 2) {
+			a = (*values)[0];
+			b = (*values)[1];
+		}
 	}
 
 	MathOp op;
@@ -2,6 +2,7 @@
 #define TWEN_MIX_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class MixNode : public Node {
 	TWEN_NODE(MixNode, "Mix")
@@ -19,14 +20,25 @@ public:
 		return Value(Utils::lerp(a, b, fac));
 	}
 
+	inline bool fuse(KernelBuilder& kb) override {
+		u16 fac = connected(2) ? kb.input(2) : kb.param(&factor);
+		kb.output(kb.op(FusedKernel::Lerp, kb.input(0), kb.input(1), fac));
+		return true;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("factor", factor);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["factor"] = factor;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		factor = json["factor"];
+		factor = json.value("factor", factor);
 	}
 
 	float factor;
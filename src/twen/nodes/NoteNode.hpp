@@ -2,11 +2,12 @@
 #define TWEN_NOTE_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class NoteNode : public Node {
 	TWEN_NODE(NoteNode, "Note")
 public:
-	inline NoteNode(Note note, u32 oct=0)
+	inline NoteNode(Note note=Note::C, u32 oct=0)
 		: Node(), note(note), oct(oct)
 	{
 		addInput("Base");
@@ -17,16 +18,22 @@ public:
 		return Value(u32(note) + (12 * oct) + base);
 	}
 
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("note", int(note), "Note");
+		ex.param("oct", oct);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["note"] = int(note);
 		json["oct"] = oct;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		note = Note(json["note"].get<int>());
-		oct = json["oct"];
+		note = Note(json.value("note", int(note)));
+		oct = json.value("oct", oct);
 	}
 
 	Note note;
@@ -46,11 +53,20 @@ public:
 		return Value(Utils::noteFrequency(in(0).value()));
 	}
 
+	inline bool fuse(KernelBuilder& kb) override {
+		kb.output(kb.op(FusedKernel::NoteFrequency, kb.input(0)));
+		return true;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
 	}
 };
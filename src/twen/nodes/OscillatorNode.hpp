@@ -2,6 +2,7 @@
 #define TWEN_OSCILLATOR_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 #include <cmath>
 
 class Phase {
@@ -21,6 +22,9 @@ public:
 		m_phase = 0.0f;
 	}
 
+	void saveState(StateWriter& w) const { w << m_phase; }
+	void restoreState(StateReader& r) { r >> m_phase; }
+
 private:
 	float m_phase, m_period;
 };
@@ -61,22 +65,42 @@ public:
 		}
 	}
 
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("frequency", frequency);
+		ex.param("waveForm", int(waveForm), "OscillatorNode::WaveForm");
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["frequency"] = frequency;
 		json["waveForm"] = int(waveForm);
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		frequency = json["frequency"];
-		waveForm = WaveForm(json["waveForm"].get<int>());
+		frequency = json.value("frequency", frequency);
+		waveForm = WaveForm(json.value("waveForm", int(waveForm)));
 	}
 
-	inline void reset() {
+	inline void reset() override {
 		m_phase.reset();
 	}
 
+	inline bool deterministic() const override {
+		return waveForm != Noise;
+	}
+
+	inline void saveState(StateWriter& w) const override {
+		m_phase.saveState(w);
+		w << m_lastNoise;
+	}
+
+	inline void restoreState(StateReader& r) override {
+		m_phase.restoreState(r);
+		r >> m_lastNoise;
+	}
+
 	float frequency;
 	WaveForm waveForm;
 
@@ -2,6 +2,7 @@
 #define TWEN_OUT_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class OutNode : public Node {
 	TWEN_NODE(OutNode, "Output")
@@ -38,14 +39,22 @@ public:
 		return Value(std::min(std::max((input * 0.5f / m_envelope), -1.0f), 1.0f));
 	}
 
+	inline void saveState(StateWriter& w) const override { w << m_signalDC << m_envelope; }
+	inline void restoreState(StateReader& r) override { r >> m_signalDC >> m_envelope; }
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("gain", gain);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["gain"] = gain;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		gain = json["gain"];
+		gain = json.value("gain", gain);
 	}
 
 	float gain = 1.0f;
@@ -2,6 +2,7 @@
 #define TWEN_REMAP_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class RemapNode : public Node {
 	TWEN_NODE(RemapNode, "Remap")
@@ -17,18 +18,39 @@ public:
 		return Value(Utils::remap(in(0).value(), fromMin, fromMax, toMin, toMax));
 	}
 
+	inline bool fuse(KernelBuilder& kb) override {
+		kb.output(kb.op(
+			FusedKernel::Remap, kb.input(0),
+			kb.param(&fromMin), kb.param(&fromMax), kb.param(&toMin), kb.param(&toMax)
+		));
+		return true;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("fromMin", fromMin);
+		ex.param("fromMax", fromMax);
+		ex.param("toMin", toMin);
+		ex.param("toMax", toMax);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["from"] = { fromMin, fromMax };
 		json["to"] = { toMin, toMax };
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		fromMin = json["from"][0];
-		fromMax = json["from"][1];
-		toMin = json["to"][0];
-		toMax = json["to"][1];
+		auto from = json.find("from"), to = json.find("to");
+		if (from != json.end() && from->is_array() && from->size() >= 2) {
+			fromMin = (*from)[0];
+			fromMax = (*from)[1];
+		}
+		if (to != json.end() && to->is_array() && to->size() >= 2) {
+			toMin = (*to)[0];
+			toMax = (*to)[1];
+		}
 	}
 
 	float fromMin, fromMax, toMin, toMax;
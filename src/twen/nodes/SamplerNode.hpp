@@ -3,6 +3,7 @@
 
 #include "../Node.h"
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 #include "../intern/Sample.h"
 
 class SamplerNode : public Node {
@@ -15,16 +16,46 @@ public:
 		sampleData.invalidate();
 	}
 
+	inline ~SamplerNode() {
+		delete m_next.exchange(nullptr);
+		delete m_retired.exchange(nullptr);
+	}
+
+	/// Picks up sampleName from the library. Everything that allocates (or
+	/// opens the file, for streamed samples) happens here, on the calling
+	/// thread; sample() only swaps the result in.
 	inline void load() {
+		delete m_retired.exchange(nullptr);
+
 		RawSample* sle = graph()->getSample(sampleName);
+		m_pending = false;
+
+		Sample* next = new Sample();
 		if (sle != nullptr) {
-			LogI("Loaded sample: ", sle->name);
-			sampleData.invalidate();
-			sampleData = Sample(sle->data, sle->sampleRate);
+			if (!sle->ready.load(std::memory_order_acquire)) {
+				// Stay silent until the loader publishes the data (see pending)
+				m_pending = true;
+			} else {
+				LogI("Loaded sample: ", sle->name);
+				if (sle->streamed()) {
+					*next = Sample(sle->data, sle->sampleRate, sle->path, sle->frames);
+				} else {
+					*next = Sample(sle->playback, sle->playbackRate);
+				}
+			}
 		}
+		delete m_next.exchange(next);
+
+		// A sleeping sampler has to run to swap it in
+		graph()->invalidate();
 	}
 
+	/// Waiting for its sample to be decoded, load() has to be called again once it is.
+	inline bool pending() const { return m_pending; }
+
 	inline Value sample(NodeGraph *graph) override {
+		adopt();
+
 		float amp = connected(0) ? in(0).velocity() : 1.0f;
 		bool gate = connected(0) ? in(0).gate() : true;
 		bool repeat = gate && !connected(0);
@@ -35,14 +66,37 @@ public:
 		return Value(s * amp);
 	}
 
+	inline bool settled() const override {
+		if (m_pending || m_next.load(std::memory_order_acquire) != nullptr) return false;
+		if (!sampleData.valid()) return true;
+		// Without a gate connected the sample loops
+		return sampleData.state() == Sample::Idle && connected(0) && !m_inputs[0].data.gate;
+	}
+
+	inline void reset() override {
+		adopt();
+		sampleData.reset();
+	}
+
+	inline void saveState(StateWriter& w) const override { sampleData.saveState(w); }
+	inline void restoreState(StateReader& r) override {
+		adopt();
+		sampleData.restoreState(r);
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.sample(sampleName);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["sample"] = sampleName;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		sampleName = json["sample"];
+		sampleName = json.value("sample", sampleName);
 		auto samples = graph()->getSampleNames();
 		auto pos = std::find(samples.begin(), samples.end(), sampleName);
 		if (pos != samples.end()) {
@@ -54,6 +108,21 @@ public:
 	Sample sampleData;
 	Str sampleName;
 	u32 sampleID;
+
+private:
+	std::atomic<bool> m_pending{ false };
+	// Built by load(), and the previous sampleData once swapped out
+	std::atomic<Sample*> m_next{ nullptr }, m_retired{ nullptr };
+
+	/// Swaps in what load() built, unless the previous one wasn't released yet.
+	inline void adopt() {
+		if (m_next.load(std::memory_order_acquire) == nullptr || m_retired.load(std::memory_order_acquire) != nullptr) return;
+		Sample* next = m_next.exchange(nullptr, std::memory_order_acq_rel);
+		if (next == nullptr) return;
+		// Swapped rather than assigned, the old buffers are released by load()
+		std::swap(sampleData, *next);
+		m_retired.store(next, std::memory_order_release);
+	}
 };
 
 #endif // TWEN_SAMPLER_NODE_H
@@ -2,6 +2,7 @@
 #define TWEN_STORAGE_NODES_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class ReaderNode : public Node {
 	TWEN_NODE(ReaderNode, "Reader")
@@ -12,14 +13,19 @@ public:
 		return graph->load(slot);
 	}
 
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("slot", slot);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["slot"] = slot;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		slot = json["slot"];
+		slot = json.value("slot", slot);
 	}
 
 	u32 slot;
@@ -38,14 +44,19 @@ public:
 		return _in;
 	}
 
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("slot", slot);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["slot"] = slot;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		slot = json["slot"];
+		slot = json.value("slot", slot);
 	}
 
 	u32 slot;
@@ -2,24 +2,35 @@
 #define TWEN_VALUE_NODE_H
 
 #include "../NodeGraph.h"
+#include "../PatchExporter.h"
 
 class ValueNode : public Node {
 	TWEN_NODE(ValueNode, "Value")
 public:
-	inline ValueNode(float v) : Node(), value(v) {}
+	inline ValueNode(float v=0.0f) : Node(), value(v) {}
 
 	inline Value sample(NodeGraph *graph) override {
 		return Value(value);
 	}
 
+	inline bool fuse(KernelBuilder& kb) override {
+		kb.output(kb.param(&value));
+		return true;
+	}
+
+	inline bool exportParams(PatchExporter& ex) override {
+		ex.param("value", value);
+		return true;
+	}
+
 	inline void save(JSON& json) override {
 		Node::save(json);
 		json["value"] = value;
 	}
 
-	inline void load(JSON json) override {
+	inline void load(const JSON& json) override {
 		Node::load(json);
-		value = json["value"];
+		value = json.value("value", value);
 	}
 
 	float value;
@@ -0,0 +1,21 @@
+// Exports a project as C++, like the editor's "Export" menu.
+// Usage: twen_export_patch project.syn Patch.cpp
+
+#include "PatchExporter.h"
+#include "Twen.h"
+
+#include <fstream>
+
+int main(int argc, char** argv) {
+	if (argc < 3) return 2;
+	Twen::init();
+
+	JSON project;
+	std::ifstream fp(argv[1]);
+	if (!fp.good()) return 1;
+	fp >> project;
+
+	PatchExporter exporter;
+	if (!exporter.build(project, PatchExporter::classNameOf(argv[2]))) return 1;
+	return exporter.write(argv[2]) ? 0 : 1;
+}
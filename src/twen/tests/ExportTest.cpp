@@ -0,0 +1,48 @@
+// The exported C++ has to play a project sample for sample like the engine.
+
+#include "Renderer.h"
+#include "ExportedPatch.cpp"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+#define EXPORT_TEST_SECONDS 10
+
+int main() {
+	Twen::init();
+
+	JSON project;
+	std::ifstream fp(TWEN_TEST_DATA "/patch.syn");
+	if (!fp.good()) return 1;
+	fp >> project;
+
+	Renderer renderer(ExportedPatch::SampleRate);
+	if (!renderer.build(project)) return 1;
+
+	const u32 frames = u32(ExportedPatch::SampleRate) * EXPORT_TEST_SECONDS;
+	Vec<float> engine(frames), exported(frames);
+	for (u32 i = 0; i < frames; i++) {
+		engine[i] = renderer.graph().sample();
+	}
+
+	ExportedPatch patch;
+	patch.render(exported.data(), frames);
+
+	double energy = 0.0;
+	for (u32 i = 0; i < frames; i++) {
+		if (engine[i] != exported[i]) {
+			std::printf("Sample %u differs: %.9g (engine), %.9g (exported)\n", i, engine[i], exported[i]);
+			return 1;
+		}
+		energy += std::abs(engine[i]);
+	}
+
+	// Two silent renders would match too
+	if (energy == 0.0) {
+		std::printf("The patch is silent\n");
+		return 1;
+	}
+	std::printf("%u samples match\n", frames);
+	return 0;
+}
@@ -0,0 +1,113 @@
+// MIDI jobs play a Standard MIDI File into the project's MIDI nodes through
+// MidiReceiver. Jobs render side by side, so nothing they build may touch
+// shared state such as a live input bus.
+
+#include "BatchRenderer.h"
+#include "MidiFile.h"
+#include "TAudio.h"
+#include "Twen.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+#define MIDI_JOB_COUNT 4
+
+/// Plays the note held on channel 1 as its value.
+class ProbeNode : public Node, public MidiReceiver {
+	TWEN_NODE(ProbeNode, "Probe")
+public:
+	int midiChannel() override { return 0; }
+
+	void midiEvent(const MidiEvent& event) override {
+		m_note = event.data0;
+		m_gate = event.command() == 0x9 && event.data1 > 0;
+	}
+
+	Value sample(NodeGraph* graph) override { return Value(float(m_note), 1.0f, m_gate); }
+
+private:
+	u8 m_note{ 0 };
+	bool m_gate{ false };
+};
+
+// Format 0, 480 ticks per quarter at the default 120 bpm (22050 frames):
+// C4 for a quarter, a rest of an eighth, then D4 for an eighth (running status).
+static const u8 Song[] = {
+	'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xE0,
+	'M', 'T', 'r', 'k', 0, 0, 0, 22,
+	0x00, 0x90, 60, 100,
+	0x83, 0x60, 0x80, 60, 0,
+	0x81, 0x70, 0x90, 62, 100,
+	0x81, 0x70, 62, 0,
+	0x00, 0xFF, 0x2F, 0x00
+};
+
+int main() {
+	Twen::init();
+	NodeBuilder::registerType<ProbeNode>("Test", TWEN_NODE_FAC { return new ProbeNode(); });
+
+	const fs::path dir = "midi_job";
+	fs::create_directories(dir);
+	{
+		std::ofstream fp(dir / "song.mid", std::ios::binary);
+		fp.write(reinterpret_cast<const char*>(Song), sizeof(Song));
+	}
+	{
+		JSON project = {
+			{ "bpm", 120 },
+			{ "bars", 4 },
+			{ "nodes", { { { "type", "ProbeNode" } } } },
+			{ "connections", { { { "from", 1 }, { "to", 0 }, { "slot", 0 } } } }
+		};
+		std::ofstream fp(dir / "probe.syn");
+		fp << project;
+	}
+	{
+		JSON manifest;
+		manifest["output"] = "out";
+		manifest["format"] = 32;
+		manifest["threads"] = MIDI_JOB_COUNT;
+		for (u32 i = 0; i < MIDI_JOB_COUNT; i++) {
+			manifest["jobs"].push_back({ { "project", "probe.syn" }, { "midi", "song.mid" }, { "stems", { 0 } } });
+		}
+		std::ofstream fp(dir / "manifest.json");
+		fp << manifest;
+	}
+
+	BatchRenderer batch;
+	if (!batch.load((dir / "manifest.json").u8string())) return 1;
+	if (batch.run() != 0) return 1;
+
+	const Vec<u64> expected = { 0, 22050, 33075, 44100 };
+	for (u32 i = 0; i < MIDI_JOB_COUNT; i++) {
+		char name[32];
+		std::snprintf(name, sizeof(name), "%04u-0.wav", i + 1);
+		TAudioFile stem((dir / "out" / name).u8string());
+		if (!stem.valid()) {
+			std::printf("Missing stem %s\n", name);
+			return 1;
+		}
+
+		Vec<float> data(stem.frames());
+		data.resize(stem.readf(data.data(), data.size()));
+
+		Vec<u64> edges;
+		bool held = false;
+		for (u64 f = 0; f < data.size(); f++) {
+			if ((data[f] != 0.0f) != held) {
+				held = !held;
+				edges.push_back(f);
+			}
+		}
+		if (edges != expected) {
+			std::printf("Job %u: the notes don't start and stop where the file says\n", i + 1);
+			return 1;
+		}
+	}
+
+	std::printf("%u MIDI jobs rendered\n", MIDI_JOB_COUNT);
+	return 0;
+}
@@ -0,0 +1,94 @@
+// A "parallel" job renders the song in segments on worker threads and joins
+// them with a short crossfade. For a patch that repeats every loop it has to
+// match the same job rendered on one thread, up to the rounding of the fades.
+
+#include "BatchRenderer.h"
+#include "TAudio.h"
+#include "Twen.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+// Long enough for three segments of a few loops each
+#define PARALLEL_JOB_SECONDS 30.0
+#define PARALLEL_JOB_TOLERANCE 1e-3f
+
+static Vec<float> readAll(const fs::path& fileName) {
+	TAudioFile snd(fileName.u8string());
+	Vec<float> data(snd.valid() ? snd.frames() : 0);
+	data.resize(snd.valid() ? snd.readf(data.data(), data.size()) : 0);
+	return data;
+}
+
+int main() {
+	Twen::init();
+
+	const fs::path dir = "parallel_job";
+	fs::create_directories(dir);
+	{
+		// A decaying sine, played on every step
+		Vec<float> kick(3000);
+		for (u32 i = 0; i < kick.size(); i++) kick[i] = std::sin(float(i) * 0.05f) * (1.0f - float(i) / float(kick.size()));
+		TAudioFile fp((dir / "kick.wav").u8string(), true, 44100, 1, TAudioFile::SampleFormat(32));
+		fp.writef(kick.data(), kick.size());
+	}
+	{
+		JSON project = {
+			{ "bpm", 120 },
+			{ "bars", 1 },
+			{ "nodes", {
+				{ { "type", "ArpNode" }, { "note", 0 }, { "chord", 0 }, { "direction", 0 }, { "oct", 0 } },
+				{ { "type", "SamplerNode" }, { "sample", "kick.wav" } },
+				{ { "type", "FilterNode" }, { "cutOff", 2000 }, { "filter", 0 } },
+				{ { "type", "DelayLineNode" }, { "feedBack", 0.3 }, { "delay", 50 } }
+			} },
+			{ "connections", {
+				{ { "from", 1 }, { "to", 2 }, { "slot", 0 } },
+				{ { "from", 2 }, { "to", 3 }, { "slot", 0 } },
+				{ { "from", 3 }, { "to", 4 }, { "slot", 0 } },
+				{ { "from", 4 }, { "to", 0 }, { "slot", 0 } }
+			} }
+		};
+		std::ofstream fp(dir / "loop.syn");
+		fp << project;
+	}
+	{
+		const Str project = "loop.syn";
+		JSON manifest;
+		manifest["output"] = "out";
+		manifest["format"] = 32;
+		manifest["threads"] = 2;
+		manifest["seconds"] = PARALLEL_JOB_SECONDS;
+		manifest["samples"] = { "kick.wav" };
+		manifest["jobs"].push_back({ { "project", project } });
+		manifest["jobs"].push_back({ { "project", project }, { "parallel", true } });
+		manifest["jobs"].push_back({ { "project", project }, { "parallel", true }, { "stems", { 0 } } });
+		std::ofstream fp(dir / "manifest.json");
+		fp << manifest;
+	}
+
+	BatchRenderer batch;
+	if (!batch.load((dir / "manifest.json").u8string())) return 1;
+	// Stems can't be split, the last job has to fail
+	if (batch.run() != 1) {
+		std::printf("Expected only the parallel job with stems to fail\n");
+		return 1;
+	}
+
+	const Vec<float> serial = readAll(dir / "out" / "0001.wav");
+	const Vec<float> parallel = readAll(dir / "out" / "0002.wav");
+	if (serial.empty() || serial.size() != parallel.size()) {
+		std::printf("Lengths differ: %zu serial, %zu parallel\n", serial.size(), parallel.size());
+		return 1;
+	}
+
+	float diff = 0.0f;
+	for (size_t i = 0; i < serial.size(); i++) diff = std::max(diff, std::abs(serial[i] - parallel[i]));
+	std::printf("Parallel render maxdiff=%g\n", diff);
+	return diff <= PARALLEL_JOB_TOLERANCE ? 0 : 1;
+}
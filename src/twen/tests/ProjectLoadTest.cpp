@@ -0,0 +1,107 @@
+// Load-time benchmark of ProjectReader against parsing the whole project into
+// a JSON document, the way projects used to be loaded. A large project with
+// embedded samples is generated first; both paths have to give the same
+// document and the same sample data.
+
+#include "ProjectReader.h"
+#include "NodeGraph.h"
+#include "Twen.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+#define PROJECT_LOAD_NODES 400
+#define PROJECT_LOAD_SAMPLES 4
+#define PROJECT_LOAD_SAMPLE_SIZE 250000
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double msSince(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main() {
+	Twen::init();
+
+	const fs::path dir = "project_load";
+	fs::create_directories(dir);
+	const Str fileName = (dir / "large.syn").u8string();
+	{
+		JSON project;
+		project["title"] = "Large \"project\" [with] {brackets}";
+		project["bpm"] = 128.0f;
+		project["bars"] = 4;
+		for (u32 i = 0; i < PROJECT_LOAD_NODES; i++) {
+			JSON node;
+			node["type"] = "OscillatorNode";
+			node["frequency"] = 110.0f + float(i);
+			node["waveForm"] = i % 4;
+			node["label"] = "osc " + std::to_string(i);
+			node["pos"] = { i * 10, i * 5 };
+			node["open"] = i % 2 == 0;
+			project["nodes"].push_back(node);
+			project["connections"].push_back({ { "from", i + 1 }, { "to", 0 }, { "slot", 0 } });
+		}
+		for (u32 s = 0; s < PROJECT_LOAD_SAMPLES; s++) {
+			Vec<float> data(PROJECT_LOAD_SAMPLE_SIZE);
+			for (u32 i = 0; i < data.size(); i++) data[i] = std::sin(float(i) * 0.01f * float(s + 1));
+
+			JSON sample;
+			sample["data"] = data;
+			sample["sampleSize"] = data.size();
+			sample["sampleName"] = "sample" + std::to_string(s) + ".wav";
+			sample["sampleRate"] = 44100.0f;
+			project["samples"].push_back(sample);
+		}
+		std::ofstream fp(fileName);
+		fp << project;
+	}
+	std::printf("Project: %.1f MB\n", double(fs::file_size(fileName)) / (1024.0 * 1024.0));
+
+	// The whole file as one document, samples converted afterwards
+	auto start = Clock::now();
+	JSON dom;
+	{
+		std::ifstream fp(fileName);
+		fp >> dom;
+	}
+	Vec<Vec<float>> domSamples;
+	for (const JSON& sample : dom["samples"]) domSamples.push_back(sample["data"].get<Vec<float>>());
+	const double domMs = msSince(start);
+
+	start = Clock::now();
+	ProjectReader reader;
+	if (!reader.read(fileName)) {
+		std::printf("ProjectReader could not read the project\n");
+		return 1;
+	}
+	const double readerMs = msSince(start);
+
+	std::printf("DOM: %.1f ms, ProjectReader: %.1f ms (%.1fx)\n", domMs, readerMs, domMs / readerMs);
+
+	// The reader leaves the samples out of the document
+	JSON expected = dom;
+	expected["samples"] = JSON::array();
+	if (reader.document() != expected) {
+		std::printf("The documents differ\n");
+		return 1;
+	}
+
+	if (reader.samples().size() != domSamples.size()) {
+		std::printf("%zu samples read, %zu expected\n", reader.samples().size(), domSamples.size());
+		return 1;
+	}
+	for (u32 s = 0; s < domSamples.size(); s++) {
+		const RawSample& sample = *reader.samples()[s];
+		if (sample.name != dom["samples"][s]["sampleName"].get<Str>() || sample.sampleRate != 44100.0f || *sample.data != domSamples[s]) {
+			std::printf("Sample %u differs\n", s);
+			return 1;
+		}
+	}
+	return 0;
+}